@@ -1,17 +1,22 @@
 #ifndef IPC_H
 #define IPC_H
 
+#include "../include/hardware.h"
 #include "../include/queue.h"
 
 #define PIPE_LEN	1024
 #define IPC_ERROR	-1
 #define IPC_BLOCK	-2
+// Unmapped Pages Left Below the User Stack When Placing Shared Memory
+#define SHM_STACK_GAP	4
 
 
 typedef enum{
 	PIPE,
 	LOCK,
 	COND,
+	SHM,
+	RWLOCK,
 }Type;
 
 typedef struct{
@@ -26,6 +31,7 @@ typedef struct{
 	char *write_ptr;
 	Queue readQueue;
 	Queue writeQueue;
+	Queue pollQueue;
 }Pipe;
 
 typedef struct{
@@ -38,16 +44,46 @@ typedef struct{
 	Queue waitQueue;
 }Cond;
 
+typedef struct{
+	Queue readers;		// Holders in Shared Mode
+	void *writer;
+	Queue readQueue;
+	Queue writeQueue;
+}RWLock;
+
+typedef struct{
+	int npg;
+	int mappers;
+	struct pte *frames;	// Holds One Reference on Every Frame
+	Queue mapQueue;
+}Shm;
+
+typedef struct{
+	void *proc;
+	int startPage;
+}ShmMap;
+
 void InitIPC(void);
 int KernelPipeInit(int *);
-int KernelPipeRead(int, void *, int);
-int KernelPipeWrite(int, void *, int);
+int KernelPipeRead(int, void *, int, int);
+int KernelPipeWrite(int, void *, int, int);
+int KernelPipePoll(int, int, int);
+void KernelPipeUnhook(int);
 int KernelLockInit(int *);
 int KernelAcquire(int);
 int KernelRelease(int);
 int KernelCvarInit(int *);
 int KernelCvarNotify(int, int);
 int KernelWait(int, int);
+int KernelRWLockInit(int *);
+int KernelRWAcquire(int, int);
+int KernelRWRelease(int);
+int KernelShmInit(int *, int);
+int KernelShmAttach(int);
+void KernelShmFork(void *, void *);
+void KernelShmDetachAll(void *);
 void KernelReclaim(int);
+void KernelIpcCancel(void *);
+void WakePollers(Queue *);
 
 #endif
@@ -1,8 +1,15 @@
 #ifndef PCB_H
 #define PCB_H
 #include "../include/hardware.h"
+#include "../include/msg.h"
 #include "../include/queue.h"
 
+// Bytes at the Top of the Parent's Stack Restored When a VFork Child Releases It
+#define VFORK_STACK_SAVE	256
+#define PCB_NAME_LEN		32
+// Return Address Pushed for a Thread's Function, Returning to It Ends the Thread
+#define THREAD_RETURN_PC	0
+
 enum State{
 	NEW,
 	READY,
@@ -11,6 +18,7 @@ enum State{
 
 typedef struct _PCB{
 	int pid;
+	char name[PCB_NAME_LEN];	// Program Loaded by the Last Exec, Truncated
 	int exitStatus;
 	struct _PCB *parent;
 	Queue children;
@@ -19,15 +27,39 @@ typedef struct _PCB{
 	void *brkR1;
 	void *stackR1;
 	int clockticks;
+	int polling;
+	int handoff;
+	void *ring;
+	void *ttyBuf;		// Buffer of a Blocked TtyRead, Filled by the Receive Interrupt
+	int ttyLen;
+	int ttyCount;
+	char msg[MSG_LEN];	// Message Sent, Replaced by the Reply
+	int msgState;
+	int receiving;		// Blocked in Receive
+	Queue msgQueue;		// Senders Waiting for Receive
+	Queue msgPending;	// Received Senders Waiting for Reply
+	Queue mappings;		// Mapped File Sectors
+	struct _PCB *vforkParent;	// Blocked Parent Whose Region 1 Is Borrowed
+	struct _PCB *group;	// Process Whose Region 1 a Thread Runs in, NULL for a Process
+	Queue threads;		// Live Threads of a Process
+	Queue deadThreads;	// Ended Threads Not Joined yet
+	struct _PCB *joiner;	// Thread Blocked in ThreadJoin on This One
+	int threadStack;	// First Page of a Thread's Stack, the Guard Page
+	int exiting;		// Process Blocked in Exit until Its Threads End
+	int killed;		// Thread of an Exiting Process, Ends When It Next Runs
+	int uninterruptible;	// In Waits That End on Their Own, Disk Transfers and Page Loads
 	enum State state;
 	UserContext uctxt;
 	KernelContext kctxt;
-	struct pte pageTableR1[VMEM_1_PNUM];
+	struct pte *pageTableR1;	// ownPageTableR1, or the Parent's after VFork
+	struct pte ownPageTableR1[VMEM_1_PNUM];
 	struct pte pageTableStackR0[KERNEL_STACK_PNUM];
 }PCB;
 
 
 PCB *createPCB(UserContext *uctxt);
 void deallocPCB(PCB *pcb);
+int WakePCB(PCB *pcb);
+PCB *GroupOf(PCB *proc);
 
 #endif
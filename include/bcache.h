@@ -0,0 +1,35 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "../include/disk.h"
+#include "../include/hardware.h"
+#include "../include/queue.h"
+
+#define BCACHE_ERROR	-1
+#define BCACHE_BLOCK	-2
+#define BCACHE_HASH	64
+// Dirty Buffers Older than This Are Written back by the Clock Tick
+#define BCACHE_FLUSH_TICKS	10
+
+typedef struct Buffer{
+	int sector;			// -1 if Unused
+	int valid;			// data Holds the Sector
+	int dirty;
+	int busy;			// Disk Transfer in Flight
+	unsigned int dirtyTick;
+	struct Buffer *hashNext;
+	struct Buffer *lruPrev;		// Toward the Most Recently Used
+	struct Buffer *lruNext;
+	Queue waitQueue;		// Processes Waiting for the Transfer
+	DiskRequest req;
+	char data[SECTORSIZE];
+}Buffer;
+
+void InitBcache(int);
+int BcacheRead(int, void *, int);
+int BcacheWrite(int, void *);
+int BcachePrefetch(int);
+void BcacheTick(void);
+int BcacheSync(void);
+
+#endif
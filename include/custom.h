@@ -0,0 +1,328 @@
+#ifndef CUSTOM_H
+#define CUSTOM_H
+
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+/*
+ * Kernel extensions are multiplexed over the three custom system calls.
+ * The first argument of CustomN is the operation, the other three are
+ * the operation's arguments.
+ *
+ *	Custom0: IPC and terminal extensions
+ *	Custom1: Memory and process extensions
+ *	Custom2: Kernel statistics and tuning
+ */
+
+#define CUSTOM_OP(x)		((x) & 0xFF)
+#define CUSTOM_FLAGS(x)		((x) & ~0xFF)
+
+// Custom0 Operations
+#define CUSTOM_POLL		0x01
+#define CUSTOM_PIPE_READ	0x02
+#define CUSTOM_PIPE_WRITE	0x03
+#define CUSTOM_TTY_READ		0x04
+#define CUSTOM_SHM_INIT		0x05
+#define CUSTOM_SHM_ATTACH	0x06
+#define CUSTOM_RW_INIT		0x07
+#define CUSTOM_RW_ACQUIRE	0x08
+#define CUSTOM_RW_RELEASE	0x09
+#define CUSTOM_RING_SETUP	0x0A
+#define CUSTOM_RING_ENTER	0x0B
+#define CUSTOM_PREFETCH		0x0C
+
+// Custom1 Operations
+#define CUSTOM_MMAP		0x01
+#define CUSTOM_MUNMAP		0x02
+#define CUSTOM_SPAWN		0x03
+#define CUSTOM_VFORK		0x04
+#define CUSTOM_THREAD_CREATE	0x05
+#define CUSTOM_THREAD_JOIN	0x06
+#define CUSTOM_THREAD_EXIT	0x07
+
+// Custom2 Operations
+#define CUSTOM_TICKS		0x01
+#define CUSTOM_TTY_STATS	0x02
+#define CUSTOM_SWITCHES		0x03
+#define CUSTOM_DISK_STATS	0x04
+#define CUSTOM_DISK_POLICY	0x05
+#define CUSTOM_BCACHE_STATS	0x06
+#define CUSTOM_EXEC_STATS	0x07
+#define CUSTOM_EXEC_FLUSH	0x08
+#define CUSTOM_SYS_STATS	0x09
+#define CUSTOM_SYS_RESET	0x0A
+#define CUSTOM_TRACE		0x0B
+#define CUSTOM_TRACE_DUMP	0x0C
+#define CUSTOM_PROF		0x0D
+#define CUSTOM_PROF_READ	0x0E
+#define CUSTOM_PROF_DUMP	0x0F
+#define CUSTOM_KSTAT		0x10
+#define CUSTOM_BCACHE_SYNC	0x11
+
+// Poll Events
+#define POLL_PIPE_IN		0x1
+#define POLL_PIPE_OUT		0x2
+#define POLL_TTY_IN		0x4
+#define POLL_INVALID		0x8
+
+// Flags of Extended Reads and Writes, or-ed into the operation
+#define IO_NONBLOCK		0x100	// Return AGAIN instead of blocking
+#define IO_PARTIAL		0x200	// Return whatever is available (>= 1 byte)
+
+// Reader-Writer Lock Modes
+#define RW_SHARED		0
+#define RW_EXCLUSIVE		1
+
+// Returned by IO_NONBLOCK calls that would block (EAGAIN)
+#define AGAIN			(-3)
+
+typedef struct{
+	int id;			// Pipe Id or Terminal Id
+	int events;		// Requested Events
+	int revents;		// Returned Events
+}PollFd;
+
+typedef struct{
+	unsigned int txBytes;		// Bytes Transmitted
+	unsigned int txBlockedTicks;	// Clock Ticks Writers Spent Blocked
+	unsigned int txQueued;		// Bytes Waiting in the Transmit Ring
+	unsigned int rxLines;		// Lines Received
+	unsigned int rxDrops;		// Lines Dropped on Receive Ring Overflow
+	unsigned int rxQueued;		// Lines Waiting in the Receive Ring
+}TtyStats;
+
+// Disk Scheduling Policies
+#define DISK_FIFO		0
+#define DISK_SCAN		1	// Sweep up and down
+#define DISK_CSCAN		2	// Sweep up, then restart at the lowest sector
+
+// Disk Latency Histogram Bucket i Counts Latencies below 2^i Ticks
+#define DISK_HIST_LEN		16
+
+typedef struct{
+	unsigned int reads;		// Completed Sector Reads
+	unsigned int writes;		// Completed Sector Writes
+	unsigned int queued;		// Requests Waiting for the Disk
+	unsigned int latencyTicks;	// Total Submit to Completion Ticks
+	unsigned int maxLatency;
+	unsigned int merged;		// Reads Served by Another Read of the Sector
+	unsigned int starved;		// Requests Served ahead of the Sweep
+	unsigned int seekSectors;	// Total Head Movement in Sectors
+	unsigned int latencyHist[DISK_HIST_LEN];
+}DiskStats;
+
+typedef struct{
+	unsigned int capacity;		// Cached Sectors, Set by bcache=N at Boot
+	unsigned int hits;		// Reads Served from the Cache
+	unsigned int misses;		// Reads Waiting for the Disk
+	unsigned int writes;
+	unsigned int writebacks;	// Dirty Sectors Written to the Disk
+	unsigned int evictions;
+	unsigned int prefetches;	// Reads Started by Prefetch
+	unsigned int reads;
+	unsigned int readTicks;		// Total ReadSector Ticks
+	unsigned int maxReadTicks;
+}BcacheStats;
+
+typedef struct{
+	unsigned int images;		// Programs Held by the Exec Cache
+	unsigned int hits;		// Execs Served without Reading the File
+	unsigned int misses;
+	unsigned int invalidations;	// Images Dropped on a Changed mtime
+	unsigned int evictions;
+	unsigned int textFrames;	// Frames Holding Cached Text
+	unsigned int dataBytes;		// Kernel Heap Holding Cached Data
+	unsigned int framesReused;	// Frames Kept by Exec for the New Image
+	unsigned int framesAllocated;	// Frames Exec Took from the Free List
+	unsigned int framesFreed;	// Frames Exec Gave back
+}ExecStats;
+
+// Statistics Are Kept per System Call Code & YALNIX_MASK
+#define SYS_CALLS		256
+// Latency Histogram Bucket i Counts Latencies below 2^i
+#define SYS_HIST_LEN		16
+
+typedef struct{
+	unsigned int calls;
+	unsigned int errors;		// Calls Returning ERROR
+	unsigned int ticks;		// Total Clock Ticks from Trap to Return
+	unsigned int usecs;		// Total Host Microseconds, the Proxy for Instructions
+	unsigned int tickHist[SYS_HIST_LEN];
+	unsigned int usecHist[SYS_HIST_LEN];
+}SysStats;
+
+// Profiler Modes, a Sample Is Taken at Each Clock Interrupt
+#define PROF_OFF		0
+#define PROF_PAGE		1	// Bucket by the Page of the pc
+#define PROF_PC			2	// Bucket by pc and Its PROF_DEPTH - 1 Callers
+#define PROF_DEPTH		4
+#define PROF_BUCKETS		128	// Distinct Buckets per Profile, Power of 2
+
+typedef struct{
+	unsigned int pc[PROF_DEPTH];	// Sampled pc, then Return Addresses, 0 past the Last
+	unsigned int count;
+}ProfBucket;
+
+/*
+ * Threads run in the region 1 of the process that created them, each on
+ * a stack of THREAD_STACK_PAGES pages with a guard page below.  A thread
+ * ends by ThreadExit or by returning from its function, and is reaped by
+ * ThreadJoin from any thread of the process.  Exit in a thread is
+ * ThreadExit, Exit in the process waits for its threads to end.
+ * Exec and VFork fail while a process has threads, and the user library's
+ * malloc is not locked.
+ */
+#define THREAD_STACK_PAGES	4
+
+/*
+ * Kernel statistics snapshot, filled by KStat.  version changes whenever
+ * the layout does, size is the number of bytes the kernel filled, which
+ * is less than sizeof(KStatSnap) for a short buffer.  Processes beyond
+ * KSTAT_PROCS are counted in procs but not listed.
+ */
+#define KSTAT_VERSION		2
+#define KSTAT_PROCS		64
+#define KSTAT_NAME_LEN		32
+
+// Process States in a Snapshot
+#define KSTAT_RUNNING		0
+#define KSTAT_READY		1
+#define KSTAT_DELAY		2	// In Delay or a Poll Timeout
+#define KSTAT_TTY		3	// Blocked on a Terminal
+#define KSTAT_WAIT		4	// In Wait for a Child
+#define KSTAT_BLOCKED		5	// On IPC, Messages, the Disk or VFork
+
+typedef struct{
+	int pid;
+	int ppid;			// 0 for an Orphan or a Thread
+	int group;			// pid of the Process a Thread Runs in, 0 for a Process
+	int state;
+	int residentPages;		// Valid Region 1 Pages, Borrowed Ones Excluded
+	int sharedPages;		// Of Those, Frames Mapped More than Once
+	int brkPages;			// Heap End, in Pages from the Region 1 Base
+	int stackPages;			// Pages from the Stack Bottom to the Region 1 Limit
+	char name[KSTAT_NAME_LEN];
+}KStatProc;
+
+typedef struct{
+	unsigned int txQueued;		// Bytes Waiting in the Transmit Ring
+	unsigned int rxLines;		// Lines Waiting in the Receive Ring
+	unsigned int readers;		// Processes Blocked in TtyRead
+	unsigned int writers;		// Processes Blocked in TtyWrite
+}KStatTty;
+
+typedef struct{
+	unsigned int version;
+	unsigned int size;
+	unsigned int ticks;
+	unsigned int switches;
+	// Physical Memory in Frames
+	unsigned int totalFrames;
+	unsigned int freeFrames;
+	unsigned int usedFrames;
+	unsigned int sharedFrames;	// Referenced More than Once
+	// Scheduler Queues
+	unsigned int ready;
+	unsigned int delayed;
+	unsigned int blocked;		// Every Other Live Process but the Running One
+	// IPC Objects, Waiters Are Processes Blocked on Them
+	unsigned int pipes;
+	unsigned int pipeBytes;		// Unread Bytes in All Pipes
+	unsigned int locks;
+	unsigned int cvars;
+	unsigned int rwlocks;
+	unsigned int shms;
+	unsigned int ipcWaiters;
+	KStatTty tty[NUM_TERMINALS];
+	unsigned int procs;		// Live Processes
+	KStatProc proc[KSTAT_PROCS];
+}KStatSnap;
+
+/*
+ * Submission ring: the process queues calls in sq[] and advances sqTail,
+ * then RingEnter(n) runs up to n of them in one trap.  Each call's
+ * return value is posted to cq[] under the submitted tag.
+ * Allowed calls: PipeRead/Write, Acquire/Release, CvarSignal/Broadcast,
+ * TtyRead/Write, Delay, GetPid and the Custom0 pipe, tty and RWLock calls.
+ */
+#define RING_ENTRIES		32
+
+typedef struct{
+	int code;		// YALNIX_* Call Number
+	int args[4];
+	int tag;
+}RingSqe;
+
+typedef struct{
+	int tag;
+	int result;
+}RingCqe;
+
+typedef struct{
+	unsigned int sqHead;	// Advanced by the Kernel
+	unsigned int sqTail;	// Advanced by the Process
+	unsigned int cqHead;	// Advanced by the Process
+	unsigned int cqTail;	// Advanced by the Kernel
+	RingSqe sq[RING_ENTRIES];
+	RingCqe cq[RING_ENTRIES];
+}Ring;
+
+// Block until one of fds is ready, timeout in clock ticks (< 0 for infinite)
+#define Poll(fds, n, timeout)	Custom0(CUSTOM_POLL, (int)(fds), (n), (timeout))
+#define PipeReadEx(id, buf, len, flags)	Custom0(CUSTOM_PIPE_READ | (flags), (id), (int)(buf), (len))
+#define PipeWriteEx(id, buf, len, flags) Custom0(CUSTOM_PIPE_WRITE | (flags), (id), (int)(buf), (len))
+#define TtyReadEx(id, buf, len, flags)	Custom0(CUSTOM_TTY_READ | (flags), (id), (int)(buf), (len))
+#define RWLockInit(id_ptr)	Custom0(CUSTOM_RW_INIT, (int)(id_ptr), 0, 0)
+#define RWAcquire(id, mode)	Custom0(CUSTOM_RW_ACQUIRE, (id), (mode), 0)
+#define RWRelease(id)		Custom0(CUSTOM_RW_RELEASE, (id), 0, 0)
+// Start reading n sectors into the buffer cache without waiting, return reads started
+#define Prefetch(sectors, n)	Custom0(CUSTOM_PREFETCH, (int)(sectors), (n), 0)
+#define RingSetup(ring)		Custom0(CUSTOM_RING_SETUP, (int)(ring), 0, 0)
+#define RingEnter(n)		Custom0(CUSTOM_RING_ENTER, (n), 0, 0)
+// Shared memory is released by Reclaim(id) or Exit of its last mapper
+#define ShmInit(id_ptr, size)	((void *)Custom0(CUSTOM_SHM_INIT, (int)(id_ptr), (size), 0))
+#define ShmAttach(id)		((void *)Custom0(CUSTOM_SHM_ATTACH, (id), 0, 0))
+// Map n sectors at consecutive addresses, pages load on first touch
+// Dirty pages are written back by MunmapSectors, Exec or Exit
+#define MmapSectors(sectors, n)	((void *)Custom1(CUSTOM_MMAP, (int)(sectors), (n), 0))
+#define MunmapSectors(addr)	Custom1(CUSTOM_MUNMAP, (int)(addr), 0, 0)
+// Start a child running path with argv, return its pid
+#define Spawn(path, argv)	Custom1(CUSTOM_SPAWN, (int)(path), (int)(argv), 0)
+// Like Fork, but the child borrows the parent's memory and may only Exec or Exit
+// The parent resumes when it does
+#define VFork()			Custom1(CUSTOM_VFORK, 0, 0, 0)
+// Start a thread running int func(void *arg) in this process, return its pid
+#define ThreadCreate(func, arg)	Custom1(CUSTOM_THREAD_CREATE, (int)(func), (int)(arg), 0)
+// Wait for thread tid to end and store its status unless status_ptr is NULL
+#define ThreadJoin(tid, status_ptr)	Custom1(CUSTOM_THREAD_JOIN, (tid), (int)(status_ptr), 0)
+#define ThreadExit(status)	Custom1(CUSTOM_THREAD_EXIT, (status), 0, 0)
+#define GetTicks()		Custom2(CUSTOM_TICKS, 0, 0, 0)
+#define GetSwitches()		Custom2(CUSTOM_SWITCHES, 0, 0, 0)
+#define GetTtyStats(id, stats)	Custom2(CUSTOM_TTY_STATS, (id), (int)(stats), 0)
+#define GetDiskStats(stats)	Custom2(CUSTOM_DISK_STATS, (int)(stats), 0, 0)
+#define GetBcacheStats(stats)	Custom2(CUSTOM_BCACHE_STATS, (int)(stats), 0, 0)
+// Write every dirty cached sector to the disk and wait for the writes
+#define SyncSectors()		Custom2(CUSTOM_BCACHE_SYNC, 0, 0, 0)
+#define GetExecStats(stats)	Custom2(CUSTOM_EXEC_STATS, (int)(stats), 0, 0)
+// Statistics of the system call numbered code, such as YALNIX_FORK
+// Fork and VFork are counted once and timed at both returns, Exit is never timed
+#define GetSysStats(code, stats)	Custom2(CUSTOM_SYS_STATS, (int)(stats), (code), 0)
+#define ResetSysStats()		Custom2(CUSTOM_SYS_RESET, 0, 0, 0)
+// Turn the kernel event trace on (1) or off (0), return the previous state
+#define SetTrace(on)		Custom2(CUSTOM_TRACE, (on), 0, 0)
+// Write the trace to dump-name on the host, for tools/trace2chrome.py, return the events written
+#define DumpTrace(path)		Custom2(CUSTOM_TRACE_DUMP, (int)(path), 0, 0)
+// Set the profiler mode, turning it on starts new profiles, return the previous mode
+#define SetProfile(mode)	Custom2(CUSTOM_PROF, (mode), 0, 0)
+// Copy up to n ProfBuckets of the profile of pid, return the number copied
+#define ReadProfile(pid, buckets, n)	Custom2(CUSTOM_PROF_READ, (pid), (int)(buckets), (n))
+// Write all profiles to dump-name on the host, for tools/profsym.py, return the profiles written
+#define DumpProfile(path)	Custom2(CUSTOM_PROF_DUMP, (int)(path), 0, 0)
+// Fill buf with up to len bytes of a KStatSnap, return the bytes filled
+#define KStat(buf, len)		Custom2(CUSTOM_KSTAT, (int)(buf), (len), 0)
+// Drop every cached program image, the next Exec of each reads its file
+#define FlushExecCache()	Custom2(CUSTOM_EXEC_FLUSH, 0, 0, 0)
+// Return the previous policy
+#define SetDiskPolicy(policy)	Custom2(CUSTOM_DISK_POLICY, (policy), 0, 0)
+
+#endif
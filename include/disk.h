@@ -0,0 +1,26 @@
+#ifndef DISK_H
+#define DISK_H
+
+#include "../include/hardware.h"
+
+typedef struct DiskRequest{
+	int op;			// DISK_READ or DISK_WRITE
+	int sector;
+	char *buf;		// SECTORSIZE Bytes of Kernel Memory
+	void *proc;		// Process Blocked on the Request
+	int done;
+	unsigned int submitTick;
+	// Called on Completion, after Waking proc
+	void (*callback)(struct DiskRequest *);
+	void *arg;
+}DiskRequest;
+
+// Requests Older than This Are Served ahead of the Sweep
+#define DISK_STARVE_TICKS	20
+
+void InitDisk(void);
+int DiskPolicy(int);
+void DiskSubmit(DiskRequest *);
+void DiskInterrupt(void);
+
+#endif
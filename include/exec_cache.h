@@ -0,0 +1,27 @@
+#ifndef EXEC_CACHE_H
+#define EXEC_CACHE_H
+
+#include <sys/types.h>
+#include <time.h>
+
+#include "../include/hardware.h"
+#include "../include/load_info.h"
+
+#define EXEC_CACHE_SIZE	8
+#define EXEC_PATH_LEN	64
+
+typedef struct{
+	char path[EXEC_PATH_LEN];	// Empty if Unused
+	time_t mtime;			// Of the File When Loaded
+	off_t size;
+	struct load_info li;
+	struct pte *text;		// Pristine Text Frames, Mapped into Each Exec
+	char *data;			// Pristine Initialized Data Pages
+	unsigned int lastUse;
+}ExecImage;
+
+ExecImage *ExecCacheFind(char *, time_t *, off_t *);
+void ExecCacheInsert(char *, time_t, off_t, struct load_info *, struct pte *);
+void ExecCacheFlush(void);
+
+#endif
@@ -13,6 +13,7 @@ void trap_memory_handler(UserContext *);
 void trap_math_handler(UserContext *);
 void trap_tty_rev_handler(UserContext *);
 void trap_tty_trans_handler(UserContext *);
+void trap_disk_handler(UserContext *);
 void trap_dummy_handler(UserContext *);
 
 
@@ -0,0 +1,7 @@
+#ifndef KSTAT_H
+#define KSTAT_H
+#include "../include/custom.h"
+
+void KernelKStat(KStatSnap *);
+
+#endif
@@ -7,5 +7,18 @@ int AllocPageFrame(struct pte *pageTable, int startPage, int count, int prot);
 void DeallocPageFrame(struct pte *pageTable, int startPage, int count);
 void DuplicateKernelStack(struct pte *target);
 void DuplicateUserAll(struct pte *target);
+void ZeroPageFrame(struct pte *pageTable, int startPage, int count);
+void SharePageFrame(struct pte *pageTable, int startPage, int count);
+int PageFrameShared(struct pte *entry);
+void FrameCounts(int *total, int *free, int *shared);
+int PageRangeFree(struct pte *pageTable, int startPage, int count);
+void CopyToPageTable(struct pte *pageTable, void *dst, void *src, int len);
+void CopyFromPageTable(struct pte *pageTable, void *dst, void *src, int len);
+int PageRangeValid(struct pte *pageTable, void *addr, int len, int prot);
+int FindFreePages(struct pte *pageTable, int lowPage, int highPage, int count);
+int PrivatePageFrames(struct pte *pageTable, int startPage, int count);
+int HarvestPageFrame(struct pte *pageTable, int startPage, int count, int *pool);
+int ReusePageFrame(struct pte *pageTable, int startPage, int count, int prot, int *pool, int *poolCount);
+void ReleasePageFrame(int *pool, int count);
 
 #endif
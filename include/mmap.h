@@ -0,0 +1,29 @@
+#ifndef MMAP_H
+#define MMAP_H
+
+#include "../include/hardware.h"
+#include "../include/queue.h"
+
+#define SECTORS_PER_PAGE	(PAGESIZE / SECTORSIZE)
+
+// Page States, Frames Are Reserved at Mmap
+#define MAP_ABSENT	0	// Not Loaded, Mapped PROT_NONE
+#define MAP_CLEAN	1	// Loaded, Mapped Read Only to Catch the First Write
+#define MAP_DIRTY	2	// Written, Mapped Read Write
+#define MAP_LOADING	3	// Being Read from Its Sectors, Still Mapped PROT_NONE
+
+typedef struct{
+	int startPage;
+	int npg;
+	int *sectors;		// SECTORS_PER_PAGE per Page, 0 Where Nothing Backs It
+	char *state;		// MAP_* per Page
+	int busy;		// Loads and Flushes in Progress, Munmap Waits for None
+	Queue waitQueue;	// Threads Waiting for a Load or Flush to End
+}Mapping;
+
+int KernelMmap(int *, int);
+Mapping *FindMapping(void *, int);
+void KernelMmapFork(void *, void *);
+void FreeMapping(void *, Mapping *);
+
+#endif
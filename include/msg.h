@@ -0,0 +1,26 @@
+#ifndef MSG_H
+#define MSG_H
+
+// All Messages Are 32 Bytes
+#define MSG_LEN		32
+#define MAX_SERVICES	16
+
+// Sender States
+#define MSG_NONE	0
+#define MSG_SENT	1	// Waiting in the Receiver's msgQueue
+#define MSG_RECEIVED	2	// Received, Waiting for the Reply
+#define MSG_REPLIED	3
+#define MSG_FAILED	4	// Receiver Exited
+
+void InitMsg(void);
+int KernelRegister(unsigned int);
+int KernelSend(void *, int);
+int KernelReceive(void *);
+int KernelReply(void *, int);
+void *KernelMsgSender(int);
+int KernelCopyFrom(int, void *, void *, int);
+int KernelCopyTo(int, void *, void *, int);
+void KernelMsgExit(void *);
+void KernelMsgCancel(void *);
+
+#endif
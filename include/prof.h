@@ -0,0 +1,43 @@
+#ifndef PROF_H
+#define PROF_H
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/PCB.h"
+
+/*
+ * Clock driven profiler.  Each clock interrupt counts the interrupted pc
+ * in the profile of the running process and program, see the PROF_*
+ * modes of custom.h.  Profiles outlive their process so they can be read
+ * or dumped after it exits, tools/profsym.py symbolizes a dump.
+ */
+
+#define PROF_PROCS	16	// Profiles Kept, Exited Processes Included
+#define PROF_MAGIC	0x46525059	// "YPRF"
+#define PROF_VERSION	1
+
+typedef struct{
+	int pid;			// 0 for an Unused Profile
+	char name[PCB_NAME_LEN];	// Program Loaded by the Last Exec
+	unsigned int samples;
+	unsigned int lost;		// Samples That Found No Free Bucket
+	unsigned int used;		// Buckets Holding a Count
+	ProfBucket buckets[PROF_BUCKETS];
+}Profile;
+
+// Header of a Dump, Followed by profiles Profiles
+typedef struct{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int mode;
+	unsigned int profiles;
+	unsigned int lost;		// Samples That Found No Free Profile
+}ProfHeader;
+
+extern int profMode;
+
+void ProfSample(UserContext *);
+int ProfControl(int);
+int ProfRead(int, ProfBucket *, int);
+int ProfDump(char *);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * Binary event trace.  Events go to a ring of TRACE_EVENTS entries, the
+ * oldest being overwritten, and are dumped to a host file for
+ * tools/trace2chrome.py.  While tracing is off an event costs one test.
+ */
+
+#define TRACE_EVENTS	4096	// Power of 2
+#define TRACE_MAGIC	0x43525459	// "YTRC"
+#define TRACE_VERSION	1
+#define TRACE_PATH_LEN	256	// Of the Dump File Name
+// Dumps Go to DUMP_PREFIX Followed by a Plain Name, in the Simulator's Directory
+#define DUMP_PREFIX	"dump-"
+
+// Event Types and Their Arguments
+#define TRACE_SWITCH	1	// Old pid, New pid
+#define TRACE_SYSCALL	2	// Code & YALNIX_MASK, regs[0]
+#define TRACE_SYSRET	3	// Code & YALNIX_MASK, Return Value
+#define TRACE_WAKEUP	4	// Woken pid
+#define TRACE_ALLOC	5	// Frames, First Page
+#define TRACE_FREE	6	// Frames Freed, First Page
+#define TRACE_TRAP	7	// Vector, Code
+#define TRACE_TTY_RX	8	// Terminal
+#define TRACE_TTY_TX	9	// Terminal
+
+typedef struct{
+	unsigned int tick;
+	unsigned int seq;		// Orders Events within a Tick
+	unsigned short type;
+	unsigned short pid;		// 0 When No Process Runs
+	int arg0;
+	int arg1;
+}TraceEvent;
+
+// Header of a Dump, Followed by count Events from the Oldest
+typedef struct{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int count;
+	unsigned int dropped;		// Overwritten before the Dump
+}TraceHeader;
+
+/*
+ * KTrace replaces TracePrintf in the kernel.  Levels above TRACE_LEVEL,
+ * set with make TRACE_LEVEL=n, compile away with their arguments, the
+ * others still obey the runtime level.
+ */
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL	3
+#endif
+
+#define KTrace(level, args...)	do{ if((level) <= TRACE_LEVEL) TracePrintf((level), args); }while(0)
+
+extern int traceOn;
+
+#define TRACE(type, arg0, arg1)	do{ if(traceOn) TraceLog((type), (int)(arg0), (int)(arg1)); }while(0)
+
+void TraceLog(int, int, int);
+int TraceControl(int);
+int TraceDump(char *);
+int DumpOpen(char *);
+
+#endif
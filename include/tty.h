@@ -1,10 +1,41 @@
 #ifndef TTY_H
 #define TTY_H
 
+#include "../include/hardware.h"
+
+// Kernel Transmit Ring of Each Terminal
+#define TTY_TX_LEN	(4 * TERMINAL_MAX_LINE)
+// Writers Block when the Ring Is Full and Wake when It Drains below TTY_TX_LOW
+#define TTY_TX_LOW	(TTY_TX_LEN / 2)
+
+// Kernel Receive Ring of Each Terminal, Lines Are Received Straight into It
+#define TTY_RX_LEN	(4 * TERMINAL_MAX_LINE)
+#define TTY_RX_LINES	64
+
 typedef struct{
-	char *buf;
-	char *ptr;
-	int count;
-}Block;
+	char buf[TTY_RX_LEN];
+	int start[TTY_RX_LINES];	// Offset of the Unread Part of Each Line
+	int len[TTY_RX_LINES];		// Unread Bytes of Each Line
+	int first;			// Oldest Line
+	int lines;			// Queued Lines
+	int tail;			// End of the Newest Line
+	unsigned int received;		// Lines Received
+	unsigned int drops;		// Lines Dropped on Overflow
+}RxRing;
+
+typedef struct{
+	char buf[TTY_TX_LEN];
+	int head;			// Next Byte to Transmit
+	int count;			// Queued Bytes, Including Those in Transmission
+	int sending;			// Bytes Handed to TtyTransmit
+	unsigned int bytes;		// Bytes Transmitted
+	unsigned int blockedTicks;	// Clock Ticks Writers Spent Blocked
+}TxRing;
+
+void InitTty(void);
+int TtyReceiveLine(int);
+int TtyReadLine(int, void *, int, struct pte *);
+int TtyQueueWrite(int, void *, int);
+void TtyTransmitDone(int);
 
 #endif
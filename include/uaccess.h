@@ -0,0 +1,17 @@
+#ifndef UACCESS_H
+#define UACCESS_H
+
+#include "../include/hardware.h"
+
+/*
+ * Checks of pointers passed by curProc.  Each page is looked up once in
+ * the page table, then the bytes within it are scanned without further
+ * checks.
+ */
+int ValidatePtr(void *, int, int);
+int ValidateString(char *);
+int ValidateVector(char **);
+int StrncpyFromUser(char *, char *, int);
+int CopyFromUser(void *, void *, int);
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef YFS_H
+#define YFS_H
+
+#include "../include/custom.h"
+#include "../include/filesystem.h"
+#include "../include/yalnix.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Protocol between the YFS library and the server (program/yfs).
+ * Every request is one 32-byte YfsMsg sent to -FILE_SERVER; the reply
+ * overwrites it with the result in op.  Paths and data stay in the client
+ * and are moved by the server with CopyFrom and CopyTo.
+ */
+#define YFS_OPEN	1	// buf, len: Path -> inum, len: File Size
+#define YFS_CREATE	2	// buf, len: Path -> inum of an Empty Regular File
+#define YFS_READ	3	// inum, pos, buf, len -> Bytes Read
+#define YFS_WRITE	4	// inum, pos, buf, len -> Bytes Written
+#define YFS_MKDIR	5	// buf, len: Path -> 0
+#define YFS_CONFIG	6	// arg: Read-ahead Blocks, < 0 to Query -> Previous
+#define YFS_SHUTDOWN	7
+#define YFS_UNLINK	8	// buf, len: Path of a Regular File -> 0
+#define YFS_EXTENTS	9	// inum -> Runs of Contiguous Blocks
+#define YFS_BMAP	10	// inum, pos, buf, len: Sectors of len Blocks from pos -> len
+
+// Blocks Read ahead of a Sequential Reader
+#define YFS_READAHEAD	8
+
+typedef struct{
+	int op;			// Replaced by the Result in the Reply
+	int inum;
+	int pos;
+	int len;
+	void *buf;
+	int arg;
+	int pad[2];
+}YfsMsg;
+
+#define SEEK_SET	0
+#define SEEK_CUR	1
+
+/*
+ * Client library.  User programs are linked from a single object, so
+ * the calls are compiled into every program that includes this header.
+ */
+typedef struct{
+	int inum;		// 0 if Unused
+	int pos;
+}YfsFile;
+
+static YfsFile yfsFiles[MAX_OPEN_FILES];
+
+static int YfsCall(YfsMsg *msg)
+{
+	if(Send(msg, -FILE_SERVER) == ERROR)
+		return ERROR;
+	return msg->op;
+}
+
+
+// Send a path operation and open the resulting inode
+static int YfsPath(int op, char *path)
+{
+	YfsMsg msg;
+	int fd;
+	for(fd = 0; fd < MAX_OPEN_FILES && yfsFiles[fd].inum != 0; fd++);
+	if(fd == MAX_OPEN_FILES || path == NULL)
+		return ERROR;
+	msg.op = op;
+	msg.buf = path;
+	msg.len = strlen(path) + 1;
+	int inum = YfsCall(&msg);
+	if(inum == ERROR)
+		return ERROR;
+	yfsFiles[fd].inum = inum;
+	yfsFiles[fd].pos = 0;
+	return fd;
+}
+
+
+static int Open(char *path)
+{
+	return YfsPath(YFS_OPEN, path);
+}
+
+
+static int Create(char *path)
+{
+	return YfsPath(YFS_CREATE, path);
+}
+
+
+static int Close(int fd)
+{
+	if(fd < 0 || fd >= MAX_OPEN_FILES || yfsFiles[fd].inum == 0)
+		return ERROR;
+	yfsFiles[fd].inum = 0;
+	return 0;
+}
+
+
+static int YfsData(int op, int fd, void *buf, int size)
+{
+	YfsMsg msg;
+	if(fd < 0 || fd >= MAX_OPEN_FILES || yfsFiles[fd].inum == 0 || size < 0)
+		return ERROR;
+	msg.op = op;
+	msg.inum = yfsFiles[fd].inum;
+	msg.pos = yfsFiles[fd].pos;
+	msg.buf = buf;
+	msg.len = size;
+	int count = YfsCall(&msg);
+	if(count > 0)
+		yfsFiles[fd].pos += count;
+	return count;
+}
+
+
+static int Read(int fd, void *buf, int size)
+{
+	return YfsData(YFS_READ, fd, buf, size);
+}
+
+
+static int Write(int fd, void *buf, int size)
+{
+	return YfsData(YFS_WRITE, fd, buf, size);
+}
+
+
+static int Seek(int fd, int offset, int whence)
+{
+	if(fd < 0 || fd >= MAX_OPEN_FILES || yfsFiles[fd].inum == 0)
+		return ERROR;
+	if(whence == SEEK_CUR)
+		offset += yfsFiles[fd].pos;
+	else if(whence != SEEK_SET)
+		return ERROR;
+	if(offset < 0)
+		return ERROR;
+	yfsFiles[fd].pos = offset;
+	return offset;
+}
+
+
+// Number of contiguous block runs holding the file
+static int Extents(int fd)
+{
+	YfsMsg msg;
+	if(fd < 0 || fd >= MAX_OPEN_FILES || yfsFiles[fd].inum == 0)
+		return ERROR;
+	msg.op = YFS_EXTENTS;
+	msg.inum = yfsFiles[fd].inum;
+	return YfsCall(&msg);
+}
+
+
+// Map len bytes of the file from offset, a multiple of BLOCKSIZE
+// Stores past the end of the file are not kept, and the file does not grow
+static void *Mmap(int fd, int offset, int len)
+{
+	YfsMsg msg;
+	int n = (len + BLOCKSIZE - 1) / BLOCKSIZE;
+	if(fd < 0 || fd >= MAX_OPEN_FILES || yfsFiles[fd].inum == 0 || offset < 0 || len <= 0)
+		return NULL;
+	int *sectors = malloc(n * sizeof(int));
+	if(sectors == NULL)
+		return NULL;
+	msg.op = YFS_BMAP;
+	msg.inum = yfsFiles[fd].inum;
+	msg.pos = offset;
+	msg.len = n;
+	msg.buf = sectors;
+	void *addr = NULL;
+	if(YfsCall(&msg) != ERROR)
+		addr = MmapSectors(sectors, n);
+	free(sectors);
+	if((int)addr == ERROR)
+		return NULL;
+	return addr;
+}
+
+
+static int Munmap(void *addr)
+{
+	return MunmapSectors(addr);
+}
+
+
+static int MkDir(char *path)
+{
+	YfsMsg msg;
+	msg.op = YFS_MKDIR;
+	msg.buf = path;
+	msg.len = strlen(path) + 1;
+	return YfsCall(&msg);
+}
+
+
+static int Unlink(char *path)
+{
+	YfsMsg msg;
+	msg.op = YFS_UNLINK;
+	msg.buf = path;
+	msg.len = strlen(path) + 1;
+	return YfsCall(&msg);
+}
+
+
+// Set the server's read-ahead window, return the previous one
+static int SetReadAhead(int blocks)
+{
+	YfsMsg msg;
+	msg.op = YFS_CONFIG;
+	msg.arg = blocks;
+	return YfsCall(&msg);
+}
+
+
+static int Shutdown(void)
+{
+	YfsMsg msg;
+	msg.op = YFS_SHUTDOWN;
+	return YfsCall(&msg);
+}
+
+#endif
@@ -1,5 +1,12 @@
+#include "../include/IPC.h"
 #include "../include/mm.h"
+#include "../include/mmap.h"
 #include "../include/PCB.h"
+#include "../include/trace.h"
+
+extern Queue readyQueue;
+// Every PCB from createPCB to deallocPCB
+Queue procQueue;
 
 static pid = 1;
 
@@ -7,27 +14,73 @@ PCB *createPCB(UserContext *uctxt)
 {
 	PCB *pcb = (PCB *)malloc(sizeof(PCB));
 	if(pcb != NULL){
-		TracePrintf(0, "createPCB:  Pages\n");
+		KTrace(3, "createPCB:  Pages\n");
 		memcpy(&pcb->uctxt, uctxt, sizeof(UserContext));
 		pcb->state = NEW;
+		pcb->polling = 0;
+		pcb->handoff = 0;
+		pcb->ring = NULL;
+		pcb->msgState = MSG_NONE;
+		pcb->receiving = 0;
+		pcb->msgQueue.head = pcb->msgQueue.tail = NULL;
+		pcb->msgPending.head = pcb->msgPending.tail = NULL;
+		pcb->mappings.head = pcb->mappings.tail = NULL;
 		pcb->pid = pid++;
+		pcb->name[0] = '\0';
 		pcb->children.head = pcb->children.tail = NULL;
 		pcb->deadChildren.head = pcb->deadChildren.tail = NULL;
-		memset(pcb->pageTableR1, 0, sizeof(pcb->pageTableR1));
+		pcb->vforkParent = NULL;
+		pcb->group = NULL;
+		pcb->threads.head = pcb->threads.tail = NULL;
+		pcb->deadThreads.head = pcb->deadThreads.tail = NULL;
+		pcb->joiner = NULL;
+		pcb->threadStack = 0;
+		pcb->exiting = 0;
+		pcb->killed = 0;
+		pcb->uninterruptible = 0;
+		pcb->pageTableR1 = pcb->ownPageTableR1;
+		memset(pcb->ownPageTableR1, 0, sizeof(pcb->ownPageTableR1));
 		int result = AllocPageFrame(pcb->pageTableStackR0, 0, KERNEL_STACK_PNUM, PROT_READ | PROT_WRITE);
 		if(result == -1){
-			TracePrintf(0, "createPCB: No Enough Physical Memory for Pages\n");
+			KTrace(0, "createPCB: No Enough Physical Memory for Pages\n");
+			free(pcb);
+			pcb = NULL;
+		}else if(push(&procQueue, pcb) == -1){
+			KTrace(0, "createPCB: No Enough Physical Memory for PCB\n");
+			DeallocPageFrame(pcb->pageTableStackR0, 0, KERNEL_STACK_PNUM);
 			free(pcb);
 			pcb = NULL;
 		}
 	}else
-		TracePrintf(0, "createPCB: No Enough Physical Memory for PCB\n");
+		KTrace(0, "createPCB: No Enough Physical Memory for PCB\n");
 	return pcb;
 }
 
 
 void deallocPCB(PCB *pcb)
 {
+	remove(&procQueue, pcb);
+	KernelShmDetachAll(pcb);
+	KernelMsgExit(pcb);
+	while(pcb->mappings.head != NULL)
+		FreeMapping(pcb, pcb->mappings.head->content);
 	DeallocPageFrame(pcb->pageTableR1, 0, VMEM_1_PNUM);
 	DeallocPageFrame(pcb->pageTableStackR0, 0, KERNEL_STACK_PNUM);
 }
+
+
+// The process whose region 1 proc runs in
+PCB *GroupOf(PCB *proc)
+{
+	if(proc->group != NULL)
+		return proc->group;
+	return proc;
+}
+
+
+// Make pcb ready to run, return -1 if it can't be queued
+int WakePCB(PCB *pcb)
+{
+	TRACE(TRACE_WAKEUP, pcb->pid, 0);
+	return push(&readyQueue, pcb);
+}
@@ -0,0 +1,271 @@
+#include "../include/bcache.h"
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/PCB.h"
+#include "../include/queue.h"
+#include "../include/trace.h"
+
+extern PCB *curProc;
+extern Queue readyQueue;
+extern unsigned int tickCount;
+
+static Buffer *hashTable[BCACHE_HASH];
+// Most Recently Used at lruHead
+static Buffer *lruHead;
+static Buffer *lruTail;
+// Processes Waiting for Any Buffer to Become Idle
+static Queue bufWaitQueue;
+BcacheStats bcacheStats;
+static Buffer *Lookup(int);
+static void Unhash(Buffer *);
+static void Touch(Buffer *);
+static int StartTransfer(Buffer *, int);
+static void TransferDone(DiskRequest *);
+static Buffer *GetVictim(int);
+
+// Allocate capacity buffers, 0 leaves sector calls uncached
+void InitBcache(int capacity)
+{
+	int i;
+	memset(&bcacheStats, 0, sizeof(bcacheStats));
+	bufWaitQueue.head = bufWaitQueue.tail = NULL;
+	lruHead = lruTail = NULL;
+	for(i = 0; i < BCACHE_HASH; i++)
+		hashTable[i] = NULL;
+	for(i = 0; i < capacity; i++){
+		Buffer *buf = (Buffer *)malloc(sizeof(Buffer));
+		if(buf == NULL){
+			KTrace(0, "InitBcache: Not Enough Memory, %d Buffers\n", i);
+			break;
+		}
+		memset(buf, 0, sizeof(Buffer));
+		buf->sector = -1;
+		buf->lruPrev = lruTail;
+		if(lruTail != NULL)
+			lruTail->lruNext = buf;
+		else
+			lruHead = buf;
+		lruTail = buf;
+		bcacheStats.capacity++;
+	}
+	KTrace(0, "Buffer Cache: %d Sectors\n", bcacheStats.capacity);
+}
+
+
+// Copy the sector to buf, retry is non-zero when called again after blocking
+// Return 0, or BCACHE_BLOCK after queuing curProc for the transfer
+int BcacheRead(int sector, void *buf, int retry)
+{
+	Buffer *b = Lookup(sector);
+	if(b != NULL && b->valid){
+		if(!retry)
+			bcacheStats.hits++;
+		memcpy(buf, b->data, SECTORSIZE);
+		Touch(b);
+		return 0;
+	}
+	if(!retry)
+		bcacheStats.misses++;
+	if(b == NULL){
+		b = GetVictim(1);
+		if(b == NULL)
+			return BCACHE_BLOCK;
+		b->sector = sector;
+		b->hashNext = hashTable[sector % BCACHE_HASH];
+		hashTable[sector % BCACHE_HASH] = b;
+		if(StartTransfer(b, DISK_READ) == -1){
+			Unhash(b);
+			return BCACHE_ERROR;
+		}
+	}
+	// Another Process Started the Read
+	if(push(&b->waitQueue, curProc) == -1)
+		return BCACHE_ERROR;
+	return BCACHE_BLOCK;
+}
+
+
+// Copy buf into the cache, the sector reaches the disk on write-back
+int BcacheWrite(int sector, void *buf)
+{
+	Buffer *b = Lookup(sector);
+	if(b == NULL){
+		b = GetVictim(1);
+		if(b == NULL)
+			return BCACHE_BLOCK;
+		b->sector = sector;
+		b->hashNext = hashTable[sector % BCACHE_HASH];
+		hashTable[sector % BCACHE_HASH] = b;
+	}else if(b->busy){
+		if(push(&b->waitQueue, curProc) == -1)
+			return BCACHE_ERROR;
+		return BCACHE_BLOCK;
+	}
+	memcpy(b->data, buf, SECTORSIZE);
+	b->valid = 1;
+	if(!b->dirty){
+		b->dirty = 1;
+		b->dirtyTick = tickCount;
+	}
+	bcacheStats.writes++;
+	Touch(b);
+	return 0;
+}
+
+
+// Start reading the sector unless cached, return 1 if a read started
+int BcachePrefetch(int sector)
+{
+	if(Lookup(sector) != NULL)
+		return 0;
+	Buffer *b = GetVictim(0);
+	if(b == NULL)
+		return 0;
+	b->sector = sector;
+	b->hashNext = hashTable[sector % BCACHE_HASH];
+	hashTable[sector % BCACHE_HASH] = b;
+	if(StartTransfer(b, DISK_READ) == -1){
+		Unhash(b);
+		return 0;
+	}
+	bcacheStats.prefetches++;
+	return 1;
+}
+
+
+// Called from the clock tick, write back buffers dirty for BCACHE_FLUSH_TICKS
+void BcacheTick(void)
+{
+	Buffer *b;
+	for(b = lruTail; b != NULL; b = b->lruPrev){
+		if(b->dirty && !b->busy && tickCount - b->dirtyTick >= BCACHE_FLUSH_TICKS)
+			StartTransfer(b, DISK_WRITE);
+	}
+}
+
+
+// Start writing back every dirty buffer
+// Return 0 once none is dirty or busy, BCACHE_BLOCK after queuing curProc on a busy one
+int BcacheSync(void)
+{
+	Buffer *b, *busy = NULL;
+	for(b = lruTail; b != NULL; b = b->lruPrev){
+		if(b->dirty && !b->busy && StartTransfer(b, DISK_WRITE) == -1)
+			return BCACHE_ERROR;
+		if(b->busy)
+			busy = b;
+	}
+	if(busy == NULL)
+		return 0;
+	if(push(&busy->waitQueue, curProc) == -1)
+		return BCACHE_ERROR;
+	return BCACHE_BLOCK;
+}
+
+
+static Buffer *Lookup(int sector)
+{
+	Buffer *b = hashTable[sector % BCACHE_HASH];
+	while(b != NULL && b->sector != sector)
+		b = b->hashNext;
+	return b;
+}
+
+
+static void Unhash(Buffer *b)
+{
+	Buffer **link = &hashTable[b->sector % BCACHE_HASH];
+	while(*link != b)
+		link = &(*link)->hashNext;
+	*link = b->hashNext;
+	b->hashNext = NULL;
+	b->sector = -1;
+	b->valid = 0;
+}
+
+
+// Move b to the most recently used end
+static void Touch(Buffer *b)
+{
+	if(b == lruHead)
+		return;
+	b->lruPrev->lruNext = b->lruNext;
+	if(b->lruNext != NULL)
+		b->lruNext->lruPrev = b->lruPrev;
+	else
+		lruTail = b->lruPrev;
+	b->lruPrev = NULL;
+	b->lruNext = lruHead;
+	lruHead->lruPrev = b;
+	lruHead = b;
+}
+
+
+// Take the least recently used idle clean buffer out of the hash
+// If only dirty ones are idle, write back the oldest and, with wait, wait for it
+// Return NULL after queuing curProc when waiting
+static Buffer *GetVictim(int wait)
+{
+	Buffer *b, *dirty = NULL;
+	for(b = lruTail; b != NULL; b = b->lruPrev){
+		if(b->busy)
+			continue;
+		if(!b->dirty)
+			break;
+		if(dirty == NULL)
+			dirty = b;
+	}
+	if(b != NULL){
+		if(b->sector != -1){
+			Unhash(b);
+			bcacheStats.evictions++;
+		}
+		Touch(b);
+		return b;
+	}
+	if(dirty != NULL && StartTransfer(dirty, DISK_WRITE) == 0){
+		if(wait)
+			push(&dirty->waitQueue, curProc);
+	}else if(wait)
+		push(&bufWaitQueue, curProc);
+	return NULL;
+}
+
+
+static int StartTransfer(Buffer *b, int op)
+{
+	b->busy = 1;
+	b->req.op = op;
+	b->req.sector = b->sector;
+	b->req.buf = b->data;
+	b->req.proc = NULL;
+	b->req.callback = TransferDone;
+	b->req.arg = b;
+	if(op == DISK_WRITE){
+		b->dirty = 0;
+		bcacheStats.writebacks++;
+	}
+	DiskSubmit(&b->req);
+	if(b->req.done == -1){
+		b->busy = 0;
+		if(op == DISK_WRITE)
+			b->dirty = 1;
+		return -1;
+	}
+	return 0;
+}
+
+
+// Called by the disk driver, wake everyone waiting for the buffer
+static void TransferDone(DiskRequest *req)
+{
+	Buffer *b = req->arg;
+	PCB *pcb;
+	b->busy = 0;
+	if(req->op == DISK_READ)
+		b->valid = 1;
+	while((pcb = pop(&b->waitQueue)) != NULL)
+		WakePCB(pcb);
+	while((pcb = pop(&bufWaitQueue)) != NULL)
+		WakePCB(pcb);
+}
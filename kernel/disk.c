@@ -0,0 +1,169 @@
+#include "../include/custom.h"
+#include "../include/disk.h"
+#include "../include/hardware.h"
+#include "../include/PCB.h"
+#include "../include/queue.h"
+#include "../include/trace.h"
+
+extern Queue readyQueue;
+extern unsigned int tickCount;
+
+// Requests Waiting for the Disk in Arrival Order
+static Queue diskQueue;
+static DiskRequest *active;
+static int policy;
+static int headSector;		// Sector of the Last Transfer
+static int direction;		// SCAN Sweep Direction, 1 Up or -1 Down
+DiskStats diskStats;
+static void StartRequest(void);
+static DiskRequest *NextRequest(void);
+static void FinishRequest(DiskRequest *);
+
+void InitDisk(void)
+{
+	diskQueue.head = diskQueue.tail = NULL;
+	active = NULL;
+	policy = DISK_CSCAN;
+	headSector = 0;
+	direction = 1;
+	memset(&diskStats, 0, sizeof(diskStats));
+}
+
+
+// Set the scheduling policy, return the previous one or -1
+int DiskPolicy(int newPolicy)
+{
+	if(newPolicy != DISK_FIFO && newPolicy != DISK_SCAN && newPolicy != DISK_CSCAN)
+		return -1;
+	int old = policy;
+	policy = newPolicy;
+	return old;
+}
+
+
+// Queue the request and start the disk if idle
+// The request is done when req->done is set by the TRAP_DISK handler
+void DiskSubmit(DiskRequest *req)
+{
+	req->done = 0;
+	req->submitTick = tickCount;
+	if(push(&diskQueue, req) == -1){
+		KTrace(0, "DiskSubmit: Not Enough Memory, Sector %d\n", req->sector);
+		req->done = -1;
+		return;
+	}
+	diskStats.queued++;
+	if(active == NULL)
+		StartRequest();
+}
+
+
+// The disk finished the active request, wake its process and start the next one
+// Queued reads of the same sector complete from the active buffer
+void DiskInterrupt(void)
+{
+	DiskRequest *req = active;
+	if(req == NULL){
+		KTrace(0, "DiskInterrupt: No Active Request\n");
+		return;
+	}
+	active = NULL;
+	FinishRequest(req);
+	if(req->op == DISK_READ){
+		Entry *entry = diskQueue.head;
+		while(entry != NULL){
+			DiskRequest *other = entry->content;
+			entry = entry->next;
+			if(other->op == DISK_WRITE && other->sector == req->sector)
+				break;
+			if(other->op == DISK_READ && other->sector == req->sector){
+				memcpy(other->buf, req->buf, SECTORSIZE);
+				remove(&diskQueue, other);
+				diskStats.queued--;
+				diskStats.merged++;
+				FinishRequest(other);
+			}
+		}
+	}
+	StartRequest();
+}
+
+
+static void FinishRequest(DiskRequest *req)
+{
+	unsigned int latency = tickCount - req->submitTick;
+	int bucket = 0;
+	while(bucket < DISK_HIST_LEN - 1 && (1u << bucket) <= latency)
+		bucket++;
+	diskStats.latencyHist[bucket]++;
+	diskStats.latencyTicks += latency;
+	if(latency > diskStats.maxLatency)
+		diskStats.maxLatency = latency;
+	if(req->op == DISK_READ)
+		diskStats.reads++;
+	else
+		diskStats.writes++;
+	req->done = 1;
+	if(req->proc != NULL)
+		WakePCB(req->proc);
+	if(req->callback != NULL)
+		req->callback(req);
+}
+
+
+static void StartRequest(void)
+{
+	active = NextRequest();
+	if(active == NULL)
+		return;
+	remove(&diskQueue, active);
+	diskStats.queued--;
+	int distance = active->sector - headSector;
+	if(distance < 0)
+		distance = -distance;
+	diskStats.seekSectors += distance;
+	headSector = active->sector;
+	DiskAccess(active->op, active->sector, active->buf);
+}
+
+
+// Pick the next request under the current policy
+// A request that waited DISK_STARVE_TICKS is served before any sweep
+static DiskRequest *NextRequest(void)
+{
+	if(diskQueue.head == NULL)
+		return NULL;
+	DiskRequest *oldest = diskQueue.head->content;
+	if(policy == DISK_FIFO)
+		return oldest;
+	if(tickCount - oldest->submitTick >= DISK_STARVE_TICKS){
+		diskStats.starved++;
+		return oldest;
+	}
+	DiskRequest *ahead = NULL, *lowest = NULL, *behind = NULL;
+	foreach(entry, &diskQueue){
+		DiskRequest *req = entry->content;
+		if(req->sector >= headSector){
+			if(ahead == NULL || req->sector < ahead->sector)
+				ahead = req;
+		}
+		if(req->sector <= headSector){
+			if(behind == NULL || req->sector > behind->sector)
+				behind = req;
+		}
+		if(lowest == NULL || req->sector < lowest->sector)
+			lowest = req;
+	}
+	if(policy == DISK_CSCAN){
+		if(ahead != NULL)
+			return ahead;
+		return lowest;
+	}
+	if(direction == 1 && ahead == NULL)
+		direction = -1;
+	else if(direction == -1 && behind == NULL)
+		direction = 1;
+	if(direction == 1)
+		return ahead;
+	return behind;
+}
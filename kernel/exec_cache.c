@@ -0,0 +1,117 @@
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/custom.h"
+#include "../include/exec_cache.h"
+#include "../include/hardware.h"
+#include "../include/mm.h"
+#include "../include/trace.h"
+
+/*
+ * Programs recently loaded by LoadProgram, keyed by path.  The cache keeps
+ * one reference on the text frames of the first process that loaded the
+ * program, later execs map the same frames read-only.  Initialized data is
+ * copied into each new address space from the pristine copy kept here.
+ */
+
+static ExecImage images[EXEC_CACHE_SIZE];
+static unsigned int useCount = 0;
+ExecStats execStats;
+static void DropImage(ExecImage *);
+
+
+static void DropImage(ExecImage *image)
+{
+	DeallocPageFrame(image->text, 0, image->li.t_npg);
+	execStats.textFrames -= image->li.t_npg;
+	execStats.dataBytes -= image->li.id_npg << PAGESHIFT;
+	execStats.images--;
+	free(image->text);
+	free(image->data);
+	memset(image, 0, sizeof(ExecImage));
+}
+
+
+// Return the image of name if its file is unchanged, NULL on a miss
+// The file's mtime and size are returned for ExecCacheInsert, mtime is 0 if it can't be stat-ed
+ExecImage *ExecCacheFind(char *name, time_t *mtime, off_t *size)
+{
+	struct stat st;
+	int i;
+	*mtime = 0;
+	*size = 0;
+	if(stat(name, &st) != 0)
+		return NULL;
+	*mtime = st.st_mtime;
+	*size = st.st_size;
+	for(i = 0; i < EXEC_CACHE_SIZE; i++){
+		if(images[i].path[0] == '\0' || strcmp(images[i].path, name) != 0)
+			continue;
+		if(images[i].mtime != st.st_mtime || images[i].size != st.st_size){
+			KTrace(2, "ExecCache: '%s' Changed, Dropped\n", name);
+			DropImage(&images[i]);
+			execStats.invalidations++;
+			break;
+		}
+		images[i].lastUse = ++useCount;
+		execStats.hits++;
+		return &images[i];
+	}
+	execStats.misses++;
+	return NULL;
+}
+
+
+// Keep the program just loaded into the active region 1
+// text points to the page table entries of its read-only text pages
+void ExecCacheInsert(char *name, time_t mtime, off_t size, struct load_info *li, struct pte *text)
+{
+	ExecImage *image = NULL;
+	int i, dataSize = li->id_npg << PAGESHIFT;
+	if(mtime == 0 || strlen(name) >= EXEC_PATH_LEN)
+		return;
+	for(i = 0; i < EXEC_CACHE_SIZE; i++){
+		if(images[i].path[0] == '\0'){
+			image = &images[i];
+			break;
+		}
+		if(image == NULL || images[i].lastUse < image->lastUse)
+			image = &images[i];
+	}
+	if(image->path[0] != '\0'){
+		KTrace(2, "ExecCache: Evict '%s'\n", image->path);
+		DropImage(image);
+		execStats.evictions++;
+	}
+	image->text = (struct pte *)malloc(li->t_npg * sizeof(struct pte));
+	image->data = (char *)malloc(dataSize);
+	if(image->text == NULL || image->data == NULL){
+		free(image->text);
+		free(image->data);
+		image->text = NULL;
+		image->data = NULL;
+		return;
+	}
+	memcpy(image->text, text, li->t_npg * sizeof(struct pte));
+	SharePageFrame(image->text, 0, li->t_npg);
+	memcpy(image->data, (void *)li->id_vaddr, dataSize);
+	strcpy(image->path, name);
+	image->mtime = mtime;
+	image->size = size;
+	image->li = *li;
+	image->lastUse = ++useCount;
+	execStats.images++;
+	execStats.textFrames += li->t_npg;
+	execStats.dataBytes += dataSize;
+}
+
+
+void ExecCacheFlush(void)
+{
+	int i;
+	for(i = 0; i < EXEC_CACHE_SIZE; i++){
+		if(images[i].path[0] != '\0')
+			DropImage(&images[i]);
+	}
+}
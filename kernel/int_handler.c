@@ -1,420 +1,884 @@
+#include "../include/bcache.h"
+#include "../include/custom.h"
+#include "../include/disk.h"
+#include "../include/exec_cache.h"
 #include "../include/hardware.h"
 #include "../include/int_handler.h"
 #include "../include/IPC.h"
+#include "../include/kstat.h"
 #include "../include/mm.h"
+#include "../include/mmap.h"
+#include "../include/msg.h"
 #include "../include/PCB.h"
+#include "../include/prof.h"
 #include "../include/queue.h"
+#include "../include/trace.h"
 #include "../include/tty.h"
+#include "../include/uaccess.h"
 #include "../include/yalnix.h"
 
+#include <sys/time.h>
+
 extern PCB *curProc;
 extern PCB *idle;
 extern Queue readyQueue;
 extern Queue clockQueue;
-extern Queue revQueue[NUM_TERMINALS];
 extern Queue revBlkQueue[NUM_TERMINALS];
 extern Queue transBlkQueue[NUM_TERMINALS];
-extern int transReady[NUM_TERMINALS];
+extern Queue ttyPollQueue[NUM_TERMINALS];
+extern TxRing txRing[NUM_TERMINALS];
+extern RxRing rxRing[NUM_TERMINALS];
+extern DiskStats diskStats;
+extern BcacheStats bcacheStats;
+extern ExecStats execStats;
+extern unsigned int tickCount;
+extern unsigned int switchCount;
+
+typedef int (*SysHandler)(UserContext *);
+SysStats sysStats[SYS_CALLS];
 
-static char ttyReceive[TERMINAL_MAX_LINE];
-static char ttyTransmit[NUM_TERMINALS][TERMINAL_MAX_LINE];
-static int ValidatePtr(void *ptr, int length, int prot);
-static int ValidateCStyle(void *pointer, int type);
 static int SwitchContext(UserContext *uctxt, Queue *queue);
-static void Die(int);
+static int PollWait(UserContext *uctxt, PollFd *fds, int n, int timeout);
+static int PipeTransfer(UserContext *uctxt, int pipe_id, void *buf, int len, int flags, int write);
+static int TtyTake(UserContext *uctxt, int tty_id, void *buf, int len, int flags);
+static int SectorTransfer(UserContext *uctxt, int op, int sector, void *buf);
+static int CachedTransfer(UserContext *uctxt, int read, int sector, void *buf);
+static int CachedSync(UserContext *uctxt);
+static void TtyDrain(UserContext *uctxt);
+static int RingRun(UserContext *uctxt, int n);
+static int RingAllowed(RingSqe *sqe);
+static int SectorIO(UserContext *uctxt, int read, int sector, void *buf);
+static int SectorBufGone(void *buf, int read);
+static int MmapFault(UserContext *uctxt, PCB *proc, Mapping *map, int page);
+static int MmapPrepare(UserContext *uctxt, PCB *proc, void *ptr, int length, int prot);
+static Mapping *MmapSettle(UserContext *uctxt, int page);
+static int MmapDirty(Mapping *map);
+static int UserPtr(UserContext *uctxt, void *ptr, int length, int prot);
+static void MmapFlush(UserContext *uctxt, Mapping *map);
+static void MmapDone(Mapping *map);
+static void UnmapAll(UserContext *uctxt);
+static void Die(UserContext *, int);
+static int ValidateArgs(char *name, char **args);
+static char **CopyArgs(char *name, char **args, char **kname);
+static int KernelSpawn(UserContext *uctxt, char *name, char **args);
+static int KernelVFork(UserContext *uctxt);
+static int VForkExec(char *name, char **args);
+static void VForkRelease(PCB *proc);
+static int KernelThreadCreate(UserContext *uctxt, void *func, void *arg);
+static int KernelThreadJoin(UserContext *uctxt, int tid, int *status_ptr);
+static void KernelThreadExit(int status);
+static void ThreadKill(PCB *thread);
+static void HoldKill(void);
+static void ReleaseKill(void);
 
-// Trap Handlers
-void trap_kernel_handler(UserContext *uctxt)
+// System Calls, Each Returns the Value Passed back in regs[0]
+static int SysGetPid(UserContext *uctxt)
 {
-	int result;
-	int retVal;
-	int count;
+	return curProc->pid;
+}
 
-	// Used by BRK
-	void *addr;
-	int startPage;
 
-	// Used by DELAY
-	int clockticks;
+static int SysBrk(UserContext *uctxt)
+{
+	void *addr = (void *)UP_TO_PAGE(uctxt->regs[0]);
+	// Threads Share the Heap of Their Process
+	PCB *proc = GroupOf(curProc);
+	int startPage, count;
+	KTrace(3, "Brk: Current Addr = %p, Current Brk = %p\n", addr, proc->brkR1);
+	if(addr <= proc->dataR1){
+		KTrace(0, "Brk : Trying to Access Text Addr\n");
+		return ERROR;
+	}else if((addr + PAGESIZE) > proc->stackR1){
+		KTrace(0, "Brk: Trying to Access Stack(Red Zone) Addr\n");
+		return ERROR;
+	}
+	// dataR1 < addr < stackR1
+	if(addr >= proc->brkR1){
+		startPage = (int)(proc->brkR1 - VMEM_1_BASE) >> PAGESHIFT;
+		count = (int)(addr - proc->brkR1) >> PAGESHIFT;
+		if(!PageRangeFree(proc->pageTableR1, startPage, count)){
+			KTrace(0, "Brk: Trying to Access Shared Memory\n");
+			return ERROR;
+		}
+		if(AllocPageFrame(proc->pageTableR1, startPage, count, PROT_READ | PROT_WRITE) == -1){
+			KTrace(0, "Brk: No Enough Physical Memory\n");
+			return ERROR;
+		}
+	}else{
+		startPage = (int)(addr - VMEM_1_BASE) >> PAGESHIFT;
+		count = (int)(proc->brkR1 - addr) >> PAGESHIFT;
+		DeallocPageFrame(proc->pageTableR1, startPage, count);
+	}
+	proc->brkR1 = addr;
+	return 0;
+}
+
 
-	// Used by FORK
+static int SysDelay(UserContext *uctxt)
+{
+	int clockticks = uctxt->regs[0];
+	if(clockticks < 0)
+		return ERROR;
+	else if(clockticks == 0)
+		return 0;
+	curProc->clockticks = clockticks;
+	if(SwitchContext(uctxt, &clockQueue) == -1){
+		KTrace(0, "DELAY: No Enough Physical Memory\n");
+		return ERROR;
+	}
+	return 0;
+}
+
+
+static int SysFork(UserContext *uctxt)
+{
 	PCB *child;
-	int page;
-	int totalPage;
 	Entry *entry;
+	int page, totalPage, result;
+	child = createPCB(uctxt);
+	if(child == NULL)
+		return ERROR;
+	child->parent = curProc;
+	strcpy(child->name, curProc->name);
+	child->dataR1 = GroupOf(curProc)->dataR1;
+	child->stackR1 = GroupOf(curProc)->stackR1;
+	child->brkR1 = GroupOf(curProc)->brkR1;
+	// Reserve Memory for Two Push
+	entry = (Entry *)malloc(2 * sizeof(Entry));
+	if(entry == NULL){
+		KTrace(0, "FORK: No Enough Physical Memory\n");
+		deallocPCB(child);
+		free(child);
+		return ERROR;
+	}
+	// Every Private Page Is Copied, Mapped Pages and Thread Stacks Included
+	totalPage = 0;
+	for(page = 0; page < VMEM_1_PNUM; page++){
+		if(curProc->pageTableR1[page].valid == 1 && !PageFrameShared(&curProc->pageTableR1[page]))
+			totalPage++;
+	}
+	result = CheckPageFrame(totalPage);
+	free(entry);
+	if(result == -1){
+		KTrace(0, "FORK: No Enough Physical Memory\n");
+		deallocPCB(child);
+		free(child);
+		return ERROR;
+	}
+	memcpy(child->pageTableR1, curProc->pageTableR1, sizeof(child->ownPageTableR1));
+	for(page = 0; page < VMEM_1_PNUM; page++){
+		if(PageFrameShared(&child->pageTableR1[page]))
+			SharePageFrame(child->pageTableR1, page, 1);
+		else if(child->pageTableR1[page].valid == 1
+			&& AllocPageFrame(child->pageTableR1, page, 1, child->pageTableR1[page].prot) == -1){
+			// The Rest Still Names the Parent's Frames without Taking References
+			KTrace(0, "FORK: No Enough Physical Memory\n");
+			memset(&child->pageTableR1[page], 0, (VMEM_1_PNUM - page) * sizeof(struct pte));
+			deallocPCB(child);
+			free(child);
+			return ERROR;
+		}
+	}
+	DuplicateUserAll(child->pageTableR1);
+	KernelShmFork(GroupOf(curProc), child);
+	KernelMmapFork(GroupOf(curProc), child);
+	push(&curProc->children, child);
+	WakePCB(child);
+	result = KernelContextSwitch(MyKCS, child, child);
+	if(result != 0){
+		KTrace(0, "KernelContextSwitch: Error!!\n");
+		exit(1);
+	}
+	if(curProc->state == READY)
+		return child->pid;
+	curProc->state = READY;
+	return 0;
+}
 
-	// Used by EXEC
-	char *fileName;
-	char **argv;
-	int i;
 
-	// Used by WAIT
-	int *status_ptr;
+static int SysExec(UserContext *uctxt)
+{
+	char *fileName = (char *)uctxt->regs[0];
+	char **argv = (char **)uctxt->regs[1];
+	int retVal;
+	if(ValidateArgs(fileName, argv) == -1)
+		return ERROR;
+	// The Other Threads Run in the Region 1 Exec Would Replace
+	if(curProc->group != NULL || curProc->threads.head != NULL)
+		return ERROR;
+	// Mapped Pages Are Written back Now, LoadProgram Drops the Mappings Once It Can't Fail
+	// Another Process May Be Loading a Page for CopyFrom, so Check All again after Blocking
+	int settled = 0;
+	while(!settled){
+		settled = 1;
+		foreach(entry, &curProc->mappings){
+			Mapping *map = entry->content;
+			if(map->busy > 0 || MmapDirty(map)){
+				MmapSettle(uctxt, map->startPage);
+				settled = 0;
+				break;
+			}
+		}
+	}
+	if(curProc->vforkParent != NULL)
+		retVal = VForkExec(fileName, argv);
+	else
+		retVal = LoadProgram(fileName, argv, curProc);
+	if(retVal == 0){
+		curProc->ring = NULL;
+		memcpy(uctxt, &curProc->uctxt, sizeof(curProc->uctxt));
+	}
+	else if(retVal == KILL)
+	{
+		KTrace(0, "EXEC: Stop Current Proc\n");
+		Die(uctxt, KILL);
+	}
+	return retVal;
+}
+
+
+static int SysExit(UserContext *uctxt)
+{
+	KTrace(3, "EXIT: Process %d Exit\n", curProc->pid);
+	Die(uctxt, uctxt->regs[0]);
+	return 0;
+}
+
+
+static int SysWait(UserContext *uctxt)
+{
+	int *status_ptr = (int *)uctxt->regs[0];
+	PCB *child;
+	int retVal;
+	if(UserPtr(uctxt, status_ptr, sizeof(int), PROT_READ | PROT_WRITE) == -1){
+		KTrace(0, "WAIT: Invalid ptr = %p\n", status_ptr);
+		return ERROR;
+	}
+	if(curProc->deadChildren.head != NULL){
+	}else if(curProc->children.head != NULL){
+		curProc->state = WAIT;
+		SwitchContext(uctxt, NULL);
+		// Another Thread May Have Unmapped status_ptr Meanwhile, the Child Waits for the Next Wait
+		if(UserPtr(uctxt, status_ptr, sizeof(int), PROT_READ | PROT_WRITE) == -1)
+			return ERROR;
+	}else
+		return ERROR;
+	child = pop(&curProc->deadChildren);
+	*status_ptr = child->exitStatus;
+	retVal = child->pid;
+	free(child);
+	return retVal;
+}
+
+
+static int SysTtyRead(UserContext *uctxt)
+{
+	int tty_id = (int)uctxt->regs[0];
+	void *buf = (void *)uctxt->regs[1];
+	int len = (int)uctxt->regs[2];
+	if(tty_id < 0 || tty_id >= NUM_TERMINALS)
+		return ERROR;
+	if(UserPtr(uctxt, buf, len, PROT_READ | PROT_WRITE) == -1)
+		return ERROR;
+	return TtyTake(uctxt, tty_id, buf, len, 0);
+}
+
+
+static int SysTtyWrite(UserContext *uctxt)
+{
+	int tty_id = (int)uctxt->regs[0];
+	void *buf = (void *)uctxt->regs[1];
+	int len = uctxt->regs[2];
+	int count, clockticks;
+	if(tty_id < 0 || tty_id >= NUM_TERMINALS)
+		return ERROR;
+	if(UserPtr(uctxt, buf, len, PROT_READ) == -1)
+		return ERROR;
+	int total = len;
+	while(len > 0){
+		count = TtyQueueWrite(tty_id, buf, len);
+		buf += count;
+		len -= count;
+		if(len > 0){
+			clockticks = tickCount;
+			SwitchContext(uctxt, &transBlkQueue[tty_id]);
+			txRing[tty_id].blockedTicks += tickCount - clockticks;
+			// Another Thread May Have Unmapped buf Meanwhile
+			if(UserPtr(uctxt, buf, len, PROT_READ) == -1)
+				return ERROR;
+		}
+	}
+	return total;
+}
+
+
+// ReadSector and WriteSector
+static int SysSector(UserContext *uctxt)
+{
+	void *buf = (void *)uctxt->regs[1];
+	int result;
+	if(uctxt->code == YALNIX_READ_SECTOR)
+		result = UserPtr(uctxt, buf, SECTORSIZE, PROT_READ | PROT_WRITE);
+	else
+		result = UserPtr(uctxt, buf, SECTORSIZE, PROT_READ);
+	if(result == -1 || (int)uctxt->regs[0] < 0 || (int)uctxt->regs[0] >= NUMSECTORS){
+		KTrace(0, "SECTOR: Invalid Sector %d or Ptr %p\n", uctxt->regs[0], buf);
+		return ERROR;
+	}
+	return SectorIO(uctxt, uctxt->code == YALNIX_READ_SECTOR, uctxt->regs[0], buf);
+}
+
+
+static int SysRegister(UserContext *uctxt)
+{
+	if(KernelRegister(uctxt->regs[0]) == IPC_ERROR)
+		return ERROR;
+	return 0;
+}
+
+
+static int SysSend(UserContext *uctxt)
+{
+	void *buf = (void *)uctxt->regs[0];
+	int retVal;
+	if(UserPtr(uctxt, buf, MSG_LEN, PROT_READ | PROT_WRITE) == -1 || KernelSend(buf, uctxt->regs[1]) == IPC_ERROR)
+		return ERROR;
+	while(curProc->msgState == MSG_SENT || curProc->msgState == MSG_RECEIVED)
+		SwitchContext(uctxt, NULL);
+	// Another Thread May Have Unmapped buf Meanwhile
+	if(curProc->msgState == MSG_REPLIED && UserPtr(uctxt, buf, MSG_LEN, PROT_READ | PROT_WRITE) == 0){
+		memcpy(buf, curProc->msg, MSG_LEN);
+		retVal = 0;
+	}else
+		retVal = ERROR;
+	curProc->msgState = MSG_NONE;
+	return retVal;
+}
+
+
+static int SysReceive(UserContext *uctxt)
+{
+	void *buf = (void *)uctxt->regs[0];
+	int result;
+	if(UserPtr(uctxt, buf, MSG_LEN, PROT_READ | PROT_WRITE) == -1)
+		return ERROR;
+	while((result = KernelReceive(buf)) == IPC_BLOCK){
+		SwitchContext(uctxt, NULL);
+		// Another Thread May Have Unmapped buf Meanwhile
+		if(UserPtr(uctxt, buf, MSG_LEN, PROT_READ | PROT_WRITE) == -1)
+			return ERROR;
+	}
+	if(result == IPC_ERROR)
+		return ERROR;
+	return result;
+}
+
+
+static int SysReply(UserContext *uctxt)
+{
+	void *buf = (void *)uctxt->regs[0];
+	if(UserPtr(uctxt, buf, MSG_LEN, PROT_READ) == -1 || KernelReply(buf, uctxt->regs[1]) == IPC_ERROR)
+		return ERROR;
+	return 0;
+}
+
+
+static int SysCopyFrom(UserContext *uctxt)
+{
+	void *buf = (void *)uctxt->regs[1];
+	int len = uctxt->regs[3];
+	PCB *sender;
+	if(UserPtr(uctxt, buf, len, PROT_READ | PROT_WRITE) == -1)
+		return ERROR;
+	// The Sender's Mapped Pages Fault in as well, It May Exit While We Block
+	while((sender = KernelMsgSender(uctxt->regs[0])) != NULL
+		&& MmapPrepare(uctxt, GroupOf(sender), (void *)uctxt->regs[2], len, PROT_READ) == 1);
+	if(KernelCopyFrom(uctxt->regs[0], buf, (void *)uctxt->regs[2], len) == IPC_ERROR)
+		return ERROR;
+	return 0;
+}
+
+
+static int SysCopyTo(UserContext *uctxt)
+{
+	void *buf = (void *)uctxt->regs[2];
+	int len = uctxt->regs[3];
+	PCB *sender;
+	if(UserPtr(uctxt, buf, len, PROT_READ) == -1)
+		return ERROR;
+	while((sender = KernelMsgSender(uctxt->regs[0])) != NULL
+		&& MmapPrepare(uctxt, GroupOf(sender), (void *)uctxt->regs[1], len, PROT_READ | PROT_WRITE) == 1);
+	if(KernelCopyTo(uctxt->regs[0], (void *)uctxt->regs[1], buf, len) == IPC_ERROR)
+		return ERROR;
+	return 0;
+}
+
+
+// PipeInit, LockInit and CvarInit
+static int SysIpcInit(UserContext *uctxt)
+{
+	int *ipc_id = (int *)uctxt->regs[0];
+	int result = IPC_ERROR;
+	if(UserPtr(uctxt, ipc_id, sizeof(int), PROT_READ | PROT_WRITE) == IPC_ERROR){
+		KTrace(0, "IPC_INIT: Invalid Ptr %p\n", ipc_id);
+		return ERROR;
+	}
+	if(uctxt->code == YALNIX_PIPE_INIT)
+		result = KernelPipeInit(ipc_id);
+	else if(uctxt->code == YALNIX_LOCK_INIT)
+		result = KernelLockInit(ipc_id);
+	else if(uctxt->code == YALNIX_CVAR_INIT)
+		result = KernelCvarInit(ipc_id);
+	else
+		KTrace(0, "IPC_INIT: Invalid Type %d\n", uctxt->code);
+	if(result == IPC_ERROR)
+		return ERROR;
+	return 0;
+}
+
+
+static int SysPipeRead(UserContext *uctxt)
+{
+	void *buf = (void *)uctxt->regs[1];
+	int len = uctxt->regs[2];
+	if(UserPtr(uctxt, buf, len, PROT_READ | PROT_WRITE) == -1){
+		KTrace(0, "PIPE_READ: Invalid Ptr %p\n", buf);
+		return ERROR;
+	}
+	return PipeTransfer(uctxt, uctxt->regs[0], buf, len, 0, 0);
+}
+
+
+static int SysPipeWrite(UserContext *uctxt)
+{
+	void *buf = (void *)uctxt->regs[1];
+	int len = uctxt->regs[2];
+	if(UserPtr(uctxt, buf, len, PROT_READ) == -1){
+		KTrace(0, "PIPE_WRITE: Invalid Ptr %p\n", buf);
+		return ERROR;
+	}
+	return PipeTransfer(uctxt, uctxt->regs[0], buf, len, 0, 1);
+}
+
+
+// Acquire, and CvarWait Which Acquires the Lock again after the Signal
+static int SysAcquire(UserContext *uctxt)
+{
+	int lock_id, result;
+	if(uctxt->code == YALNIX_CVAR_WAIT){
+		lock_id = uctxt->regs[1];
+		if(KernelWait(uctxt->regs[0], lock_id) == IPC_ERROR)
+			return ERROR;
+		SwitchContext(uctxt, NULL);
+	}else
+		lock_id = uctxt->regs[0];
+	while((result = KernelAcquire(lock_id)) == IPC_BLOCK){
+		SwitchContext(uctxt, NULL);
+	}
+	if(result == IPC_ERROR)
+		return ERROR;
+	return 0;
+}
+
+
+static int SysRelease(UserContext *uctxt)
+{
+	if(KernelRelease(uctxt->regs[0]) == IPC_ERROR)
+		return ERROR;
+	return 0;
+}
+
+
+// CvarSignal and CvarBroadcast
+static int SysCvarNotify(UserContext *uctxt)
+{
+	if(KernelCvarNotify(uctxt->regs[0], uctxt->code) == IPC_ERROR)
+		return ERROR;
+	return 0;
+}
 
-	// Used by TTYREAD TTYWRITE PIPEREAD and PIPEWRITE
-	int tty_id, pipe_id;
-	void *buf;
-	int len, total;
-	Block *block;
 
-	// Used by IPC
+static int SysReclaim(UserContext *uctxt)
+{
+	KernelReclaim(uctxt->regs[0]);
+	return 0;
+}
+
+
+static int SysCustom0(UserContext *uctxt)
+{
+	int flags = CUSTOM_FLAGS(uctxt->regs[0]);
+	void *buf;
+	int tty_id, len, count, i, result, retVal;
 	int *ipc_id;
-	int lock_id;
-	int cvar_id;
-	
-	switch(uctxt->code){
-		case YALNIX_GETPID:
-			retVal = curProc->pid;
-			break;
-		case YALNIX_BRK:
-			addr = (void *)UP_TO_PAGE(uctxt->regs[0]);
-			TracePrintf(0, "Brk: Current Addr = %p, Current Brk = %p\n", addr, curProc->brkR1);
-			if(addr <= curProc->dataR1){
-				TracePrintf(0, "Brk : Trying to Access Text Addr\n");
-				retVal = ERROR;
-				break;
-			}else if((addr + PAGESIZE) > curProc->stackR1){
-				TracePrintf(0, "Brk: Trying to Access Stack(Red Zone) Addr\n");
-				retVal = ERROR;
-				break;
-			}else{
-				// dataR1 < addr < stackR1
-				if(addr >= curProc->brkR1){
-					startPage = (int)(curProc->brkR1 - VMEM_1_BASE) >> PAGESHIFT;
-					count = (int)(addr - curProc->brkR1) >> PAGESHIFT;
-					result = AllocPageFrame(curProc->pageTableR1, startPage, count, PROT_READ | PROT_WRITE);
-					if(result == -1){
-						TracePrintf(0, "Brk: No Enough Physical Memory\n");
-						retVal = ERROR;
-						break;
-					}
-				}else{
-					startPage = (int)(addr - VMEM_1_BASE) >> PAGESHIFT;
-					count = (int)(curProc->brkR1 - addr) >> PAGESHIFT;
-					DeallocPageFrame(curProc->pageTableR1, startPage, count);
-				}
-				curProc->brkR1 = addr;
-				retVal = 0;
-			}
-			break;
-		case YALNIX_DELAY:
-			clockticks = uctxt->regs[0];
-			if(clockticks < 0){
-				retVal = ERROR;
-				break;
-			}
-			else if(clockticks == 0){
-				retVal = 0;
-			}else{
-				curProc->clockticks = clockticks;
-				result = SwitchContext(uctxt, &clockQueue);
-				if(result == -1){
-					TracePrintf(0, "DELAY: No Enough Physical Memory\n");
-					retVal = ERROR;
-					break;
-				}else{
-					retVal = 0;
-				}
-			}
-			break;
-		case YALNIX_FORK:
-			child = createPCB(uctxt);
-			if(child == NULL){
-				retVal = ERROR;
-				break;
-			}
-			else{
-				child->parent = curProc;
-				child->dataR1 = curProc->dataR1;
-				child->stackR1 = curProc->stackR1;
-				child->brkR1 = curProc->brkR1;
-				// Reserve Memory for Two Push
-				entry = (Entry *)malloc(2 * sizeof(Entry));
-				if(entry == NULL){
-					TracePrintf(0, "FORK: No Enough Physical Memory\n");
-					deallocPCB(child);
-					free(child);
-					retVal = ERROR;
-					break;
-				}
-				totalPage = ((VMEM_1_LIMIT - (int)child->stackR1) >> PAGESHIFT) + (((int)child->brkR1 - VMEM_1_BASE) >> PAGESHIFT);
-				result = CheckPageFrame(totalPage);
-				free(entry);
-				if(result == -1){
-					TracePrintf(0, "FORK: No Enough Physical Memory\n");
-					deallocPCB(child);
-					free(child);
-					retVal = ERROR;
-					break;
-				}else{
-					memcpy(child->pageTableR1, curProc->pageTableR1, sizeof(curProc->pageTableR1));
-					page = 0;
-					for(; page < VMEM_1_PNUM; page++){
-						if(child->pageTableR1[page].valid == 1){
-							AllocPageFrame(child->pageTableR1, page, 1, child->pageTableR1[page].prot);
-						}
-					}
-					DuplicateUserAll(child->pageTableR1); 
-					push(&curProc->children, child);
-					push(&readyQueue, child);
-					result = KernelContextSwitch(MyKCS, child, child); 
-					if(result != 0){
-						TracePrintf(0, "KernelContextSwitch: Error!!\n");
-						exit(1);
-					}
-					if(curProc->state == READY)
-						retVal = child->pid;
-					else{
-						curProc->state = READY;
-						retVal = 0;
-					}
-				}
-			}
-			break;
-		case YALNIX_EXEC:
-			fileName = (char *)uctxt->regs[0];
-			argv = (char **)uctxt->regs[1];
-			result = ValidateCStyle(fileName, sizeof(char));
-			if(result == -1){
-				retVal = ERROR;
-				break;
-			}
-			result = ValidateCStyle(argv, sizeof(char *));
-			if(result == -1){
-				retVal = ERROR;
-				break;
-			}
-			i = 0;
-			while(argv[i] != NULL){
-				result = ValidateCStyle(argv[i++], sizeof(char));
-				if(result == -1){
-					retVal = ERROR;
-					break;
-				}
-			}
-			retVal = LoadProgram(fileName, argv, curProc);
-			if(retVal == 0)
-				memcpy(uctxt, &curProc->uctxt, sizeof(curProc->uctxt));
-			else if(retVal == KILL)
-			{
-				TracePrintf(0, "EXEC: Stop Current Proc\n");
-				Die(KILL);
-			}
-			break;
-		case YALNIX_EXIT:
-			TracePrintf(3, "EXIT: Process %d Exit\n", curProc->pid);
-			Die(uctxt->regs[0]);
-			break;
-		case YALNIX_WAIT:
-			status_ptr = (int *)uctxt->regs[0];
-			result = ValidatePtr(status_ptr, sizeof(int), PROT_READ | PROT_WRITE);
-			if(result == -1){
-				TracePrintf(0, "WAIT: Invalid ptr = %p\n", status_ptr);
-				retVal = ERROR;
-				break;
-			}
-			if(curProc->deadChildren.head != NULL){
-			}else if(curProc->children.head != NULL){
-				curProc->state = WAIT;
-				SwitchContext(uctxt, NULL);
-			}else{
-				retVal = ERROR;
-				break;
-			}
-			child = pop(&curProc->deadChildren);
-			*status_ptr = child->exitStatus;
-			retVal = child->pid;
-			free(child);
-			break;
-		case YALNIX_TTY_READ:
-			tty_id = (int)uctxt->regs[0];
-			if(tty_id < 0 || tty_id >= NUM_TERMINALS){
-				retVal = ERROR;
-				break;
-			}
-			buf = (void *)uctxt->regs[1];
-			len = (int)uctxt->regs[2];
-			result = ValidatePtr(buf, len, PROT_READ | PROT_WRITE);
-			if(result == -1){
-				retVal = ERROR;
-				break;
-			}
-			while((entry = revQueue[tty_id].head) == NULL){
-				result = SwitchContext(uctxt, &revBlkQueue[tty_id]);
-				if(result == -1){
-					uctxt->regs[0] = ERROR;
-					return;
-				}
-			}
-			block = (Block *)entry->content;
-			if(len < block->count){
-				memcpy(buf, block->ptr, len);
-				block->ptr += len;
-				block->count -= len;
-				retVal = len;
-			}else{
-				memcpy(buf, block->ptr, block->count);
-				if(block->buf != NULL)
-					free(block->buf);
-				pop(&revQueue[tty_id]);
-				retVal = block->count;
-			}
-			break;
-		case YALNIX_TTY_WRITE:
-			tty_id = (int)uctxt->regs[0];
-			if(tty_id < 0 || tty_id >= NUM_TERMINALS){
-				retVal = ERROR;
-				break;
-			}
-			buf = (void *)uctxt->regs[1];
-			total = len = uctxt->regs[2];
-			result = ValidatePtr(buf, len, PROT_READ);
-			if(result == -1){
-				retVal = ERROR;
-				break;
-			}
-			while(len > 0){
-				while(transReady[tty_id] == 0){
-					result = SwitchContext(uctxt, &transBlkQueue[tty_id]);
-					if(result == -1)
-						continue;
-				}
-				if(len > TERMINAL_MAX_LINE)
-					count = TERMINAL_MAX_LINE;
-				else
-					count = len;
-				memcpy(&ttyTransmit[tty_id], buf, count);
-				transReady[tty_id] = 0;
-				TtyTransmit(tty_id, &ttyTransmit[tty_id], count);
-				buf += TERMINAL_MAX_LINE;
-				len -= TERMINAL_MAX_LINE;
-				SwitchContext(uctxt, &transBlkQueue[tty_id]);
-			}
-			retVal = total;
-			break;
-		case YALNIX_PIPE_INIT:
-		case YALNIX_LOCK_INIT:
-		case YALNIX_CVAR_INIT:
-			ipc_id = (int *)uctxt->regs[0];
-			result = ValidatePtr(ipc_id, sizeof(int), PROT_READ | PROT_WRITE);
-			if(result == IPC_ERROR){
-				TracePrintf(0, "IPC_INIT: Invalid Ptr %p\n", ipc_id);
-				retVal = ERROR;
-				break;
-			}
-			if(uctxt->code == YALNIX_PIPE_INIT)
-				result = KernelPipeInit(ipc_id);
-			else if(uctxt->code == YALNIX_LOCK_INIT)
-				result = KernelLockInit(ipc_id);
-			else if(uctxt->code == YALNIX_CVAR_INIT)
-				result = KernelCvarInit(ipc_id);
-			else
-				TracePrintf(0, "IPC_INIT: Invalid Type %d\n", uctxt->code);
-			if(result == IPC_ERROR)
-				retVal = ERROR;
+	PollFd *fds;
+	switch(CUSTOM_OP(uctxt->regs[0])){
+		case CUSTOM_PIPE_READ:
+		case CUSTOM_PIPE_WRITE:
+			buf = (void *)uctxt->regs[2];
+			len = uctxt->regs[3];
+			if(CUSTOM_OP(uctxt->regs[0]) == CUSTOM_PIPE_READ)
+				result = UserPtr(uctxt, buf, len, PROT_READ | PROT_WRITE);
 			else
-				retVal = 0;
-			break;
-		case YALNIX_PIPE_READ:
-			pipe_id = uctxt->regs[0];
-			buf = (void *)uctxt->regs[1];
-			total = len = uctxt->regs[2];
-			result = ValidatePtr(buf, len, PROT_READ | PROT_WRITE);
+				result = UserPtr(uctxt, buf, len, PROT_READ);
 			if(result == -1){
-				TracePrintf(0, "PIPE_READ: Invalid Ptr %p\n", buf);
-				retVal = ERROR;
-				break;
+				KTrace(0, "PIPE_TRANSFER: Invalid Ptr %p\n", buf);
+				return ERROR;
 			}
-			while(1){
-				len = KernelPipeRead(pipe_id, buf, total);
-				if(len == IPC_ERROR){
-					retVal = ERROR;
-					break;
-				}else if(len == total){
-					retVal = uctxt->regs[2];
-					break;
-				}else{
-					total -= len;
-					buf += len;
-					SwitchContext(uctxt, NULL);
-				}
-			}
-			break;
-		case YALNIX_PIPE_WRITE:
-			pipe_id = uctxt->regs[0];
+			return PipeTransfer(uctxt, uctxt->regs[1], buf, len, flags, CUSTOM_OP(uctxt->regs[0]) == CUSTOM_PIPE_WRITE);
+		case CUSTOM_TTY_READ:
+			tty_id = uctxt->regs[1];
+			buf = (void *)uctxt->regs[2];
+			len = uctxt->regs[3];
+			if(tty_id < 0 || tty_id >= NUM_TERMINALS)
+				return ERROR;
+			if(UserPtr(uctxt, buf, len, PROT_READ | PROT_WRITE) == -1)
+				return ERROR;
+			return TtyTake(uctxt, tty_id, buf, len, flags);
+		case CUSTOM_PREFETCH:
 			buf = (void *)uctxt->regs[1];
-			total = len = uctxt->regs[2];
-			result = ValidatePtr(buf, len, PROT_READ);
-			if(result == -1){
-				TracePrintf(0, "PIPE_WRITE: Invalid Ptr %p\n", buf);
-				retVal = ERROR;
-				break;
-			}
-			while(1){
-				len = KernelPipeWrite(pipe_id, buf, total);
-				if(len == IPC_ERROR){
-					retVal = ERROR;
-					break;
-				}else if(len == total){
-					retVal = uctxt->regs[2];
-					break;
-				}else{
-					total -= len;
-					buf += len;
-					SwitchContext(uctxt, NULL);
-				}
-			}
-			break;
-		case YALNIX_LOCK_ACQUIRE:
-		case YALNIX_CVAR_WAIT:
-			if(uctxt->code == YALNIX_CVAR_WAIT){
-				cvar_id = uctxt->regs[0];
-				lock_id = uctxt->regs[1];
-				result = KernelWait(cvar_id, lock_id);
-				if(result == IPC_ERROR){
-					retVal = ERROR;
-					break;
-				}else
-					SwitchContext(uctxt, NULL);
-			}else
-				lock_id = uctxt->regs[0];
-			while((result = KernelAcquire(lock_id)) == IPC_BLOCK){
+			count = uctxt->regs[2];
+			if(count <= 0 || count > NUMSECTORS || UserPtr(uctxt, buf, count * sizeof(int), PROT_READ) == -1)
+				return ERROR;
+			retVal = 0;
+			for(i = 0; i < count; i++)
+				if(((int *)buf)[i] >= 0 && ((int *)buf)[i] < NUMSECTORS)
+					retVal += BcachePrefetch(((int *)buf)[i]);
+			return retVal;
+		case CUSTOM_SHM_INIT:
+			ipc_id = (int *)uctxt->regs[1];
+			if(UserPtr(uctxt, ipc_id, sizeof(int), PROT_READ | PROT_WRITE) == -1)
+				return ERROR;
+			result = KernelShmInit(ipc_id, uctxt->regs[2]);
+			if(result == IPC_ERROR)
+				return ERROR;
+			return result;
+		case CUSTOM_RW_INIT:
+			ipc_id = (int *)uctxt->regs[1];
+			if(UserPtr(uctxt, ipc_id, sizeof(int), PROT_READ | PROT_WRITE) == -1)
+				return ERROR;
+			if(KernelRWLockInit(ipc_id) == IPC_ERROR)
+				return ERROR;
+			return 0;
+		case CUSTOM_RW_ACQUIRE:
+			result = KernelRWAcquire(uctxt->regs[1], uctxt->regs[2] == RW_EXCLUSIVE);
+			if(result == IPC_BLOCK){
+				// The Releaser Hands the Lock over, Reclaim Wakes without It
 				SwitchContext(uctxt, NULL);
+				if(curProc->handoff)
+					result = 0;
+				else
+					result = IPC_ERROR;
+				curProc->handoff = 0;
 			}
 			if(result == IPC_ERROR)
-				retVal = ERROR;
-			else
-				retVal = 0;
-			break;
-		case YALNIX_LOCK_RELEASE:
-			result = KernelRelease(uctxt->regs[0]);
+				return ERROR;
+			return 0;
+		case CUSTOM_RW_RELEASE:
+			if(KernelRWRelease(uctxt->regs[1]) == IPC_ERROR)
+				return ERROR;
+			return 0;
+		case CUSTOM_RING_SETUP:
+			if(UserPtr(uctxt, (void *)uctxt->regs[1], sizeof(Ring), PROT_READ | PROT_WRITE) == -1)
+				return ERROR;
+			curProc->ring = (void *)uctxt->regs[1];
+			return 0;
+		case CUSTOM_RING_ENTER:
+			if(curProc->ring == NULL || UserPtr(uctxt, curProc->ring, sizeof(Ring), PROT_READ | PROT_WRITE) == -1)
+				return ERROR;
+			return RingRun(uctxt, uctxt->regs[1]);
+		case CUSTOM_SHM_ATTACH:
+			result = KernelShmAttach(uctxt->regs[1]);
 			if(result == IPC_ERROR)
-				retVal = ERROR;
-			else
-				retVal = 0;
-			break;
-		case YALNIX_CVAR_SIGNAL:
-		case YALNIX_CVAR_BROADCAST:
-			result = KernelCvarNotify(uctxt->regs[0], uctxt->code);
+				return ERROR;
+			return result;
+		case CUSTOM_POLL:
+			fds = (PollFd *)uctxt->regs[1];
+			count = uctxt->regs[2];
+			// Checked before Multiplying, so the Length Can't Wrap
+			if(count <= 0 || count > VMEM_1_SIZE / sizeof(PollFd))
+				return ERROR;
+			if(UserPtr(uctxt, fds, count * sizeof(PollFd), PROT_READ | PROT_WRITE) == -1){
+				KTrace(0, "POLL: Invalid Ptr %p\n", fds);
+				return ERROR;
+			}
+			return PollWait(uctxt, fds, count, uctxt->regs[3]);
+		default:
+			KTrace(0, "Kernel Handler: Unspecified Custom0 Call %d\n", uctxt->regs[0]);
+			return ERROR;
+	}
+}
+
+
+static int SysCustom1(UserContext *uctxt)
+{
+	void *buf, *addr;
+	int count, i, page, result;
+	Mapping *map;
+	switch(CUSTOM_OP(uctxt->regs[0])){
+		case CUSTOM_SPAWN:
+			return KernelSpawn(uctxt, (char *)uctxt->regs[1], (char **)uctxt->regs[2]);
+		case CUSTOM_VFORK:
+			return KernelVFork(uctxt);
+		case CUSTOM_THREAD_CREATE:
+			return KernelThreadCreate(uctxt, (void *)uctxt->regs[1], (void *)uctxt->regs[2]);
+		case CUSTOM_THREAD_JOIN:
+			return KernelThreadJoin(uctxt, uctxt->regs[1], (int *)uctxt->regs[2]);
+		case CUSTOM_THREAD_EXIT:
+			if(curProc->group == NULL)
+				return ERROR;
+			KernelThreadExit(uctxt->regs[1]);
+			return 0;
+		case CUSTOM_MMAP:
+			buf = (void *)uctxt->regs[1];
+			count = uctxt->regs[2];
+			if(count <= 0 || count > VMEM_1_PNUM * SECTORS_PER_PAGE || UserPtr(uctxt, buf, count * sizeof(int), PROT_READ) == -1)
+				return ERROR;
+			for(i = 0; i < count; i++)
+				if(((int *)buf)[i] < 0 || ((int *)buf)[i] >= NUMSECTORS)
+					return ERROR;
+			result = KernelMmap((int *)buf, count);
 			if(result == IPC_ERROR)
-				retVal = ERROR;
-			else
-				retVal = 0;	
-			break;
-		case YALNIX_RECLAIM:
-			KernelReclaim(uctxt->regs[0]);
-			break;
+				return ERROR;
+			return VMEM_1_BASE + (result << PAGESHIFT);
+		case CUSTOM_MUNMAP:
+			addr = (void *)uctxt->regs[1];
+			page = (int)(addr - VMEM_1_BASE) >> PAGESHIFT;
+			map = NULL;
+			if((int)addr >= VMEM_1_BASE && (int)addr < VMEM_1_LIMIT)
+				map = FindMapping(GroupOf(curProc), page);
+			if(map == NULL || (int)addr != VMEM_1_BASE + (map->startPage << PAGESHIFT))
+				return ERROR;
+			// Loads and Flushes in Progress Finish First, Another Thread May Unmap It Meanwhile
+			map = MmapSettle(uctxt, page);
+			if(map == NULL || (int)addr != VMEM_1_BASE + (map->startPage << PAGESHIFT))
+				return ERROR;
+			FreeMapping(GroupOf(curProc), map);
+			return 0;
+		default:
+			KTrace(0, "Kernel Handler: Unspecified Custom1 Call %d\n", uctxt->regs[0]);
+			return ERROR;
+	}
+}
+
+
+// Copy len bytes of kernel statistics to the buffer at regs[1]
+static int CopyStats(UserContext *uctxt, void *stats, int len)
+{
+	void *buf = (void *)uctxt->regs[1];
+	if(UserPtr(uctxt, buf, len, PROT_READ | PROT_WRITE) == -1)
+		return ERROR;
+	memcpy(buf, stats, len);
+	return 0;
+}
+
+
+// Copy up to regs[2] bytes of a kernel statistics snapshot to regs[1]
+static int SysKStat(UserContext *uctxt)
+{
+	void *buf = (void *)uctxt->regs[1];
+	int len = uctxt->regs[2];
+	KStatSnap *snap;
+	if(len < 2 * (int)sizeof(unsigned int) || UserPtr(uctxt, buf, len, PROT_READ | PROT_WRITE) == -1)
+		return ERROR;
+	if((snap = (KStatSnap *)malloc(sizeof(KStatSnap))) == NULL)
+		return ERROR;
+	KernelKStat(snap);
+	if(len > sizeof(KStatSnap))
+		len = sizeof(KStatSnap);
+	snap->size = len;
+	memcpy(buf, snap, len);
+	free(snap);
+	return len;
+}
+
+
+static int SysCustom2(UserContext *uctxt)
+{
+	int tty_id, retVal;
+	TtyStats *stats;
+	char path[TRACE_PATH_LEN];
+	switch(uctxt->regs[0]){
+		case CUSTOM_TICKS:
+			return tickCount;
+		case CUSTOM_SWITCHES:
+			return switchCount;
+		case CUSTOM_DISK_POLICY:
+			retVal = DiskPolicy(uctxt->regs[1]);
+			if(retVal == -1)
+				return ERROR;
+			return retVal;
+		case CUSTOM_BCACHE_STATS:
+			return CopyStats(uctxt, &bcacheStats, sizeof(BcacheStats));
+		case CUSTOM_EXEC_STATS:
+			return CopyStats(uctxt, &execStats, sizeof(ExecStats));
+		case CUSTOM_EXEC_FLUSH:
+			ExecCacheFlush();
+			return 0;
+		case CUSTOM_DISK_STATS:
+			return CopyStats(uctxt, &diskStats, sizeof(DiskStats));
+		case CUSTOM_SYS_STATS:
+			// regs[1] Is the Buffer, regs[2] the System Call Code
+			if((int)(uctxt->regs[2] & YALNIX_MASK) >= SYS_CALLS)
+				return ERROR;
+			return CopyStats(uctxt, &sysStats[uctxt->regs[2] & YALNIX_MASK], sizeof(SysStats));
+		case CUSTOM_SYS_RESET:
+			memset(sysStats, 0, sizeof(sysStats));
+			return 0;
+		case CUSTOM_TRACE:
+			retVal = TraceControl(uctxt->regs[1]);
+			if(retVal == -1)
+				return ERROR;
+			return retVal;
+		case CUSTOM_TRACE_DUMP:
+			if(StrncpyFromUser(path, (char *)uctxt->regs[1], sizeof(path)) == -1)
+				return ERROR;
+			retVal = TraceDump(path);
+			if(retVal == -1)
+				return ERROR;
+			return retVal;
+		case CUSTOM_PROF:
+			retVal = ProfControl(uctxt->regs[1]);
+			if(retVal == -1)
+				return ERROR;
+			return retVal;
+		case CUSTOM_PROF_READ:
+			// regs[1] Is the pid, regs[2] the Buffer, regs[3] Its Length in Buckets
+			if((int)uctxt->regs[3] < 0 || (int)uctxt->regs[3] > PROF_BUCKETS ||
+				UserPtr(uctxt, (void *)uctxt->regs[2], uctxt->regs[3] * sizeof(ProfBucket), PROT_READ | PROT_WRITE) == -1)
+				return ERROR;
+			return ProfRead(uctxt->regs[1], (ProfBucket *)uctxt->regs[2], uctxt->regs[3]);
+		case CUSTOM_PROF_DUMP:
+			if(StrncpyFromUser(path, (char *)uctxt->regs[1], sizeof(path)) == -1)
+				return ERROR;
+			retVal = ProfDump(path);
+			if(retVal == -1)
+				return ERROR;
+			return retVal;
+		case CUSTOM_KSTAT:
+			return SysKStat(uctxt);
+		case CUSTOM_BCACHE_SYNC:
+			return CachedSync(uctxt);
+		case CUSTOM_TTY_STATS:
+			tty_id = uctxt->regs[1];
+			stats = (TtyStats *)uctxt->regs[2];
+			if(tty_id < 0 || tty_id >= NUM_TERMINALS || UserPtr(uctxt, stats, sizeof(TtyStats), PROT_READ | PROT_WRITE) == -1)
+				return ERROR;
+			stats->txBytes = txRing[tty_id].bytes;
+			stats->txBlockedTicks = txRing[tty_id].blockedTicks;
+			stats->txQueued = txRing[tty_id].count;
+			stats->rxLines = rxRing[tty_id].received;
+			stats->rxDrops = rxRing[tty_id].drops;
+			stats->rxQueued = rxRing[tty_id].lines;
+			return 0;
 		default:
-			TracePrintf(0, "Kernel Handler: Unspecified System Call\n");
+			KTrace(0, "Kernel Handler: Unspecified Custom2 Call %d\n", uctxt->regs[0]);
+			return ERROR;
 	}
+}
+
+
+// Indexed by code & YALNIX_MASK, NULL for Unknown Calls
+static SysHandler sysTable[SYS_CALLS] = {
+	[YALNIX_FORK & YALNIX_MASK] = SysFork,
+	[YALNIX_EXEC & YALNIX_MASK] = SysExec,
+	[YALNIX_EXIT & YALNIX_MASK] = SysExit,
+	[YALNIX_WAIT & YALNIX_MASK] = SysWait,
+	[YALNIX_GETPID & YALNIX_MASK] = SysGetPid,
+	[YALNIX_BRK & YALNIX_MASK] = SysBrk,
+	[YALNIX_DELAY & YALNIX_MASK] = SysDelay,
+	[YALNIX_TTY_READ & YALNIX_MASK] = SysTtyRead,
+	[YALNIX_TTY_WRITE & YALNIX_MASK] = SysTtyWrite,
+	[YALNIX_REGISTER & YALNIX_MASK] = SysRegister,
+	[YALNIX_SEND & YALNIX_MASK] = SysSend,
+	[YALNIX_RECEIVE & YALNIX_MASK] = SysReceive,
+	[YALNIX_REPLY & YALNIX_MASK] = SysReply,
+	[YALNIX_COPY_FROM & YALNIX_MASK] = SysCopyFrom,
+	[YALNIX_COPY_TO & YALNIX_MASK] = SysCopyTo,
+	[YALNIX_READ_SECTOR & YALNIX_MASK] = SysSector,
+	[YALNIX_WRITE_SECTOR & YALNIX_MASK] = SysSector,
+	[YALNIX_PIPE_INIT & YALNIX_MASK] = SysIpcInit,
+	[YALNIX_PIPE_READ & YALNIX_MASK] = SysPipeRead,
+	[YALNIX_PIPE_WRITE & YALNIX_MASK] = SysPipeWrite,
+	[YALNIX_LOCK_INIT & YALNIX_MASK] = SysIpcInit,
+	[YALNIX_LOCK_ACQUIRE & YALNIX_MASK] = SysAcquire,
+	[YALNIX_LOCK_RELEASE & YALNIX_MASK] = SysRelease,
+	[YALNIX_CVAR_INIT & YALNIX_MASK] = SysIpcInit,
+	[YALNIX_CVAR_SIGNAL & YALNIX_MASK] = SysCvarNotify,
+	[YALNIX_CVAR_BROADCAST & YALNIX_MASK] = SysCvarNotify,
+	[YALNIX_CVAR_WAIT & YALNIX_MASK] = SysAcquire,
+	[YALNIX_RECLAIM & YALNIX_MASK] = SysReclaim,
+	[YALNIX_CUSTOM_0 & YALNIX_MASK] = SysCustom0,
+	[YALNIX_CUSTOM_1 & YALNIX_MASK] = SysCustom1,
+	[YALNIX_CUSTOM_2 & YALNIX_MASK] = SysCustom2,
+};
+
+
+// Latency Bucket i Counts Latencies below 2^i
+static void SysRecord(unsigned int *hist, unsigned int latency)
+{
+	int bucket = 0;
+	while(bucket < SYS_HIST_LEN - 1 && (1u << bucket) <= latency)
+		bucket++;
+	hist[bucket]++;
+}
+
+
+// Trap Handlers
+void trap_kernel_handler(UserContext *uctxt)
+{
+	int code = uctxt->code & YALNIX_MASK;
+	SysStats *stats = &sysStats[code];
+	unsigned int ticks = tickCount;
+	unsigned int usecs;
+	struct timeval start, end;
+	int retVal;
+	if(sysTable[code] == NULL){
+		KTrace(0, "Kernel Handler: Unspecified System Call\n");
+		uctxt->regs[0] = ERROR;
+		return;
+	}
+	stats->calls++;
+	TRACE(TRACE_SYSCALL, code, uctxt->regs[0]);
+	gettimeofday(&start, NULL);
+	retVal = sysTable[code](uctxt);
+	// Fork and VFork Return twice, Exit Never Returns
+	gettimeofday(&end, NULL);
+	TRACE(TRACE_SYSRET, code, retVal);
+	usecs = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
+	if(retVal == ERROR)
+		stats->errors++;
+	stats->ticks += tickCount - ticks;
+	stats->usecs += usecs;
+	SysRecord(stats->tickHist, tickCount - ticks);
+	SysRecord(stats->usecHist, usecs);
 	uctxt->regs[0] = retVal;
 }
 
 
-static void Die(int exitStatus)
+static void Die(UserContext *uctxt, int exitStatus)
 {
-	if(curProc->pid == 2)
+	if(curProc->group != NULL)
+		KernelThreadExit(exitStatus);
+	// The Threads End When They Next Run, the Last to End Wakes the Process
+	if(curProc->threads.head != NULL){
+		curProc->exiting = 1;
+		foreach(entry, &curProc->threads)
+			ThreadKill(entry->content);
+		while(curProc->threads.head != NULL)
+			SwitchContext(uctxt, NULL);
+	}
+	while(curProc->deadThreads.head != NULL)
+		free(pop(&curProc->deadThreads));
+	VForkRelease(curProc);
+	UnmapAll(uctxt);
+	// Dirty Cached Sectors, Mapped Pages Included, Reach the Disk before Halting
+	// and Queued Terminal Output Reaches the Terminals
+	if(curProc->pid == 2){
+		CachedSync(uctxt);
+		TtyDrain(uctxt);
 		Halt();
+	}
 	deallocPCB(curProc);
 	// Notify Children
 	PCB *child;
@@ -429,7 +893,7 @@ static void Die(int exitStatus)
 		push(&parent->deadChildren, curProc);
 		if(parent->state == WAIT){
 			parent->state = READY;
-			push(&readyQueue, parent);
+			WakePCB(parent);
 		}
 	}else
 		free(curProc);
@@ -438,54 +902,817 @@ static void Die(int exitStatus)
 }
 
 
-static int ValidatePtr(void *ptr, int length, int prot)
+// Return the bytes taken by name and the NULL terminated args with their NULs
+// -1 if any of them is not readable
+static int ValidateArgs(char *name, char **args)
 {
-	if(ptr == NULL || length < 0){
-		TracePrintf(0, "ValidatePtr: NULL PTR or Negative Length\n");
+	int i, len;
+	int argc = ValidateVector(args);
+	int size = ValidateString(name);
+	if(argc == -1 || size == -1)
 		return -1;
+	size++;
+	for(i = 0; i < argc; i++){
+		len = ValidateString(args[i]);
+		if(len == -1)
+			return -1;
+		size += len + 1;
 	}
-	if((int)ptr < VMEM_1_BASE){
-		TracePrintf(0, "ValidatePtr: PTR in Kernel Space\n");
-		return -1;
-	}else if((int)ptr >= VMEM_1_LIMIT){
-		TracePrintf(0, "ValidatePtr: PTR over User Space\n");
+	return size;
+}
+
+
+// Copy name and args to one block of kernel heap, which outlives a change of region 1
+// Return the argument array, *kname points into the same block, NULL if unreadable
+static char **CopyArgs(char *name, char **args, char **kname)
+{
+	int i, len;
+	int argc = ValidateVector(args);
+	int size = ValidateArgs(name, args);
+	if(size == -1)
+		return NULL;
+	char **kargs = (char **)malloc((argc + 1) * sizeof(char *) + size);
+	if(kargs == NULL)
+		return NULL;
+	char *cp = (char *)&kargs[argc + 1];
+	char *end = cp + size;
+	// Pages Are Checked again While Copying, the Strings May Have Changed
+	for(i = 0; i < argc; i++){
+		kargs[i] = cp;
+		len = StrncpyFromUser(cp, args[i], end - cp);
+		if(len == -1){
+			free(kargs);
+			return NULL;
+		}
+		cp += len + 1;
+	}
+	kargs[argc] = NULL;
+	if(StrncpyFromUser(cp, name, end - cp) == -1){
+		free(kargs);
+		return NULL;
+	}
+	*kname = cp;
+	return kargs;
+}
+
+
+// Create a child running name, without copying the address space of curProc
+static int KernelSpawn(UserContext *uctxt, char *name, char **args)
+{
+	char *kname;
+	char **kargs;
+	int result;
+	kargs = CopyArgs(name, args, &kname);
+	if(kargs == NULL)
+		return ERROR;
+	PCB *child = createPCB(uctxt);
+	if(child == NULL){
+		free(kargs);
+		return ERROR;
+	}
+	// LoadProgram Fills the Active Region 1
+	WriteRegister(REG_PTBR1, (unsigned int)child->pageTableR1);
+	WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+	result = LoadProgram(kname, kargs, child);
+	WriteRegister(REG_PTBR1, (unsigned int)curProc->pageTableR1);
+	WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+	free(kargs);
+	if(result != 0){
+		KTrace(0, "SPAWN: Can't Load '%s'\n", name);
+		deallocPCB(child);
+		free(child);
+		return ERROR;
+	}
+	child->parent = curProc;
+	if(push(&curProc->children, child) == -1 || WakePCB(child) == -1){
+		remove(&curProc->children, child);
+		deallocPCB(child);
+		free(child);
+		return ERROR;
+	}
+	result = KernelContextSwitch(MyKCS, child, child);
+	if(result != 0){
+		KTrace(0, "KernelContextSwitch: Error!!\n");
+		exit(1);
+	}
+	if(curProc != child)
+		return child->pid;
+	// The Child Starts at the Entry of Its Program
+	curProc->state = READY;
+	memcpy(uctxt, &curProc->uctxt, sizeof(UserContext));
+	return 0;
+}
+
+
+// Create a child running in the region 1 of curProc, which sleeps until the child Execs or Exits
+// The top of the parent's stack, overwritten by the child's calls, is restored when it wakes
+static int KernelVFork(UserContext *uctxt)
+{
+	char saved[VFORK_STACK_SAVE];
+	int len = VFORK_STACK_SAVE;
+	int result;
+	PCB *parent = curProc;
+	if(parent->group != NULL || parent->threads.head != NULL)
+		return ERROR;
+	PCB *child = createPCB(uctxt);
+	if(child == NULL)
+		return ERROR;
+	child->parent = parent;
+	child->dataR1 = parent->dataR1;
+	child->brkR1 = parent->brkR1;
+	child->stackR1 = parent->stackR1;
+	child->pageTableR1 = parent->pageTableR1;
+	child->vforkParent = parent;
+	strcpy(child->name, parent->name);
+	if(push(&parent->children, child) == -1 || WakePCB(child) == -1){
+		remove(&parent->children, child);
+		child->pageTableR1 = child->ownPageTableR1;
+		deallocPCB(child);
+		free(child);
+		return ERROR;
+	}
+	if(len > VMEM_1_LIMIT - (int)uctxt->sp)
+		len = VMEM_1_LIMIT - (int)uctxt->sp;
+	memcpy(saved, uctxt->sp, len);
+	result = KernelContextSwitch(MyKCS, child, child);
+	if(result != 0){
+		KTrace(0, "KernelContextSwitch: Error!!\n");
+		exit(1);
+	}
+	if(curProc == child){
+		curProc->state = READY;
+		return 0;
+	}
+	// Not on Any Queue, VForkRelease Makes the Parent Ready
+	SwitchContext(uctxt, NULL);
+	memcpy(uctxt->sp, saved, len);
+	return child->pid;
+}
+
+
+// Load into the own region 1 of a VFork child, which keeps the borrowed one if nothing was loaded
+static int VForkExec(char *name, char **args)
+{
+	char *kname;
+	char **kargs = CopyArgs(name, args, &kname);
+	int result;
+	if(kargs == NULL)
+		return ERROR;
+	curProc->pageTableR1 = curProc->ownPageTableR1;
+	WriteRegister(REG_PTBR1, (unsigned int)curProc->pageTableR1);
+	WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+	result = LoadProgram(kname, kargs, curProc);
+	free(kargs);
+	if(result == ERROR){
+		curProc->pageTableR1 = curProc->vforkParent->pageTableR1;
+		WriteRegister(REG_PTBR1, (unsigned int)curProc->pageTableR1);
+		WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+	}else
+		VForkRelease(curProc);
+	return result;
+}
+
+
+// Give the parent of a VFork child its region 1 back and wake it
+static void VForkRelease(PCB *proc)
+{
+	if(proc->vforkParent == NULL)
+		return;
+	WakePCB(proc->vforkParent);
+	proc->vforkParent = NULL;
+	proc->pageTableR1 = proc->ownPageTableR1;
+}
+
+
+// Create a thread of the process of curProc, starting at func(arg) on a stack of its own
+static int KernelThreadCreate(UserContext *uctxt, void *func, void *arg)
+{
+	PCB *group = GroupOf(curProc);
+	PCB *thread;
+	unsigned int *sp;
+	int result;
+	if(curProc->vforkParent != NULL || UserPtr(uctxt, func, 1, PROT_EXEC) == -1)
+		return ERROR;
+	// Between the Heap and the Main Stack, the Lowest Page Left as a Guard
+	int lowPage = ((int)(group->brkR1 - VMEM_1_BASE) >> PAGESHIFT) + 1;
+	int highPage = ((int)(group->stackR1 - VMEM_1_BASE) >> PAGESHIFT) - SHM_STACK_GAP;
+	int stackPage = FindFreePages(group->pageTableR1, lowPage, highPage, THREAD_STACK_PAGES + 1);
+	if(stackPage == -1){
+		KTrace(0, "THREAD: No Room for a Stack in Proc %d\n", group->pid);
+		return ERROR;
+	}
+	thread = createPCB(uctxt);
+	if(thread == NULL)
+		return ERROR;
+	if(AllocPageFrame(group->pageTableR1, stackPage + 1, THREAD_STACK_PAGES, PROT_READ | PROT_WRITE) == -1){
+		deallocPCB(thread);
+		free(thread);
+		return ERROR;
+	}
+	WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+	thread->group = group;
+	thread->pageTableR1 = group->pageTableR1;
+	thread->dataR1 = group->dataR1;
+	thread->brkR1 = group->brkR1;
+	thread->stackR1 = group->stackR1;
+	thread->threadStack = stackPage;
+	strcpy(thread->name, group->name);
+	// func Finds arg above a Return Address That Ends the Thread
+	sp = (unsigned int *)(VMEM_1_BASE + ((stackPage + 1 + THREAD_STACK_PAGES) << PAGESHIFT)) - 2;
+	sp[0] = THREAD_RETURN_PC;
+	sp[1] = (unsigned int)arg;
+	thread->uctxt.pc = func;
+	thread->uctxt.sp = sp;
+	thread->uctxt.ebp = NULL;
+	if(push(&group->threads, thread) == -1 || WakePCB(thread) == -1){
+		remove(&group->threads, thread);
+		DeallocPageFrame(group->pageTableR1, stackPage, THREAD_STACK_PAGES + 1);
+		thread->pageTableR1 = thread->ownPageTableR1;
+		deallocPCB(thread);
+		free(thread);
+		return ERROR;
+	}
+	result = KernelContextSwitch(MyKCS, thread, thread);
+	if(result != 0){
+		KTrace(0, "KernelContextSwitch: Error!!\n");
+		exit(1);
+	}
+	if(curProc != thread)
+		return thread->pid;
+	if(curProc->killed)
+		KernelThreadExit(KILL);
+	// The Thread Starts at func
+	curProc->state = READY;
+	memcpy(uctxt, &curProc->uctxt, sizeof(UserContext));
+	return 0;
+}
+
+
+// Wait for thread tid of the process of curProc to end, then reap it
+static int KernelThreadJoin(UserContext *uctxt, int tid, int *status_ptr)
+{
+	PCB *group = GroupOf(curProc);
+	PCB *thread = NULL;
+	if(status_ptr != NULL && UserPtr(uctxt, status_ptr, sizeof(int), PROT_READ | PROT_WRITE) == -1)
+		return ERROR;
+	foreach(entry, &group->deadThreads){
+		if(((PCB *)entry->content)->pid == tid)
+			thread = (PCB *)entry->content;
+	}
+	if(thread == NULL){
+		foreach(live, &group->threads){
+			if(((PCB *)live->content)->pid == tid)
+				thread = (PCB *)live->content;
+		}
+		if(thread == NULL || thread == curProc || thread->joiner != NULL)
+			return ERROR;
+		// Not on Any Queue, KernelThreadExit Wakes the Joiner
+		thread->joiner = curProc;
+		SwitchContext(uctxt, NULL);
+	}else if(thread->joiner != NULL && thread->joiner != curProc)
+		return ERROR;
+	remove(&group->deadThreads, thread);
+	// Another Thread May Have Shrunk the Heap Meanwhile
+	if(status_ptr != NULL && UserPtr(uctxt, status_ptr, sizeof(int), PROT_READ | PROT_WRITE) == 0)
+		*status_ptr = thread->exitStatus;
+	free(thread);
+	return 0;
+}
+
+
+// End the thread curProc, which stays on deadThreads of its process until joined
+static void KernelThreadExit(int status)
+{
+	PCB *thread = curProc;
+	PCB *group = thread->group;
+	// Mappings and Shm Segments Are Kept on group, deallocPCB Leaves Them to the Other Threads
+	DeallocPageFrame(group->pageTableR1, thread->threadStack, THREAD_STACK_PAGES + 1);
+	thread->pageTableR1 = thread->ownPageTableR1;
+	deallocPCB(thread);
+	foreach(entry, &thread->children)
+		((PCB *)entry->content)->parent = NULL;
+	thread->exitStatus = status;
+	remove(&group->threads, thread);
+	push(&group->deadThreads, thread);
+	// A Killed Joiner Is Already Woken
+	if(thread->joiner != NULL && !thread->joiner->killed)
+		WakePCB(thread->joiner);
+	if(group->exiting && group->threads.head == NULL)
+		WakePCB(group);
+	curProc = NULL;
+	SwitchContext(NULL, NULL);
+}
+
+
+// End thread at its next run, taking it off the queue it waits on unless the wait ends on its own
+static void ThreadKill(PCB *thread)
+{
+	int i;
+	thread->killed = 1;
+	if(thread->uninterruptible > 0)
+		return;
+	remove(&readyQueue, thread);
+	remove(&clockQueue, thread);
+	for(i = 0; i < NUM_TERMINALS; i++){
+		remove(&revBlkQueue[i], thread);
+		remove(&transBlkQueue[i], thread);
+		remove(&ttyPollQueue[i], thread);
+	}
+	KernelIpcCancel(thread);
+	KernelMsgCancel(thread);
+	thread->polling = 0;
+	thread->state = READY;
+	WakePCB(thread);
+}
+
+
+// Keep a kill from ending curProc during a wait that ends on its own
+static void HoldKill(void)
+{
+	curProc->uninterruptible++;
+}
+
+
+// End curProc if it was killed during the wait
+static void ReleaseKill(void)
+{
+	if(--curProc->uninterruptible == 0 && curProc->killed)
+		KernelThreadExit(KILL);
+}
+
+
+// Move len bytes between buf and the pipe
+// Block until all is moved, until any is moved with IO_PARTIAL, or never with IO_NONBLOCK
+static int PipeTransfer(UserContext *uctxt, int pipe_id, void *buf, int len, int flags, int write)
+{
+	int count, need;
+	int total = 0;
+	while(1){
+		if(flags & IO_NONBLOCK)
+			need = 0;
+		else if(flags & IO_PARTIAL)
+			need = 1;
+		else
+			need = len;
+		if(write)
+			count = KernelPipeWrite(pipe_id, buf, len, need);
+		else
+			count = KernelPipeRead(pipe_id, buf, len, need);
+		if(count == IPC_ERROR)
+			return ERROR;
+		total += count;
+		buf += count;
+		len -= count;
+		if(len == 0 || (count > 0 && (flags & (IO_NONBLOCK | IO_PARTIAL))))
+			return total;
+		if(flags & IO_NONBLOCK)
+			return AGAIN;
+		SwitchContext(uctxt, NULL);
+		// Another Thread May Have Unmapped buf Meanwhile
+		if(write && UserPtr(uctxt, buf, len, PROT_READ) == -1)
+			return ERROR;
+		if(!write && UserPtr(uctxt, buf, len, PROT_READ | PROT_WRITE) == -1)
+			return ERROR;
+	}
+}
+
+
+// Copy one queued line of terminal input into buf
+// IO_NONBLOCK returns AGAIN when there is no input, IO_PARTIAL keeps taking queued lines
+static int TtyTake(UserContext *uctxt, int tty_id, void *buf, int len, int flags)
+{
+	int count;
+	int total = 0;
+	int taken = 0;
+	while(rxRing[tty_id].lines == 0){
+		if(flags & IO_NONBLOCK)
+			return AGAIN;
+		curProc->ttyBuf = buf;
+		curProc->ttyLen = len;
+		if(SwitchContext(uctxt, &revBlkQueue[tty_id]) == -1)
+			return ERROR;
+		// The Receive Interrupt Already Copied a Line into buf
+		if(curProc->handoff){
+			curProc->handoff = 0;
+			if(curProc->ttyCount == ERROR)
+				return ERROR;
+			total = curProc->ttyCount;
+			buf += total;
+			len -= total;
+			taken = 1;
+			break;
+		}
+		// Another Thread May Have Unmapped buf Meanwhile
+		if(UserPtr(uctxt, buf, len, PROT_READ | PROT_WRITE) == -1)
+			return ERROR;
+	}
+	while(rxRing[tty_id].lines > 0 && (!taken || ((flags & IO_PARTIAL) && len > 0))){
+		count = TtyReadLine(tty_id, buf, len, NULL);
+		buf += count;
+		len -= count;
+		total += count;
+		taken = 1;
+	}
+	return total;
+}
+
+
+// Move one sector between buf and the disk through a kernel buffer
+// Block curProc until the TRAP_DISK handler completes the request
+static int SectorTransfer(UserContext *uctxt, int op, int sector, void *buf)
+{
+	DiskRequest *req = (DiskRequest *)malloc(sizeof(DiskRequest) + SECTORSIZE);
+	if(req == NULL){
+		KTrace(0, "SECTOR: Not Enough Memory for Request\n");
+		return ERROR;
+	}
+	req->op = op;
+	req->sector = sector;
+	req->buf = (char *)(req + 1);
+	req->proc = curProc;
+	req->callback = NULL;
+	if(op == DISK_WRITE)
+		memcpy(req->buf, buf, SECTORSIZE);
+	DiskSubmit(req);
+	while(req->done == 0)
+		SwitchContext(uctxt, NULL);
+	int retVal = 0;
+	// Another Thread May Have Unmapped buf Meanwhile
+	if(req->done == -1 || (op == DISK_READ && SectorBufGone(buf, 1)))
+		retVal = ERROR;
+	else if(op == DISK_READ)
+		memcpy(buf, req->buf, SECTORSIZE);
+	free(req);
+	return retVal;
+}
+
+
+// Return 1 if another thread unmapped the user buf while its caller was blocked
+// Kernel buffers, as MmapFault reads into, always stay
+static int SectorBufGone(void *buf, int read)
+{
+	int prot = PROT_READ;
+	if(read)
+		prot |= PROT_WRITE;
+	return (int)buf >= VMEM_1_BASE && ValidatePtr(buf, SECTORSIZE, prot) == -1;
+}
+
+
+// Move one sector between buf and the disk, through the buffer cache unless it is off
+static int SectorIO(UserContext *uctxt, int read, int sector, void *buf)
+{
+	int result;
+	HoldKill();
+	if(bcacheStats.capacity > 0)
+		result = CachedTransfer(uctxt, read, sector, buf);
+	else if(read)
+		result = SectorTransfer(uctxt, DISK_READ, sector, buf);
+	else
+		result = SectorTransfer(uctxt, DISK_WRITE, sector, buf);
+	ReleaseKill();
+	return result;
+}
+
+
+// Load a mapped page of the process proc from its sectors and map it read only until written
+// The page stays PROT_NONE while loading, so other threads fault and wait for it
+// Return -1 if there is no memory to load it through
+static int MmapFault(UserContext *uctxt, PCB *proc, Mapping *map, int page)
+{
+	void *addr = (void *)(VMEM_1_BASE + (page << PAGESHIFT));
+	int *sectors = &map->sectors[(page - map->startPage) * SECTORS_PER_PAGE];
+	char *kbuf = (char *)malloc(PAGESIZE);
+	int i;
+	if(kbuf == NULL)
 		return -1;
+	HoldKill();
+	map->state[page - map->startPage] = MAP_LOADING;
+	map->busy++;
+	for(i = 0; i < SECTORS_PER_PAGE; i++){
+		if(sectors[i] == 0 || SectorIO(uctxt, 1, sectors[i], kbuf + i * SECTORSIZE) == ERROR)
+			memset(kbuf + i * SECTORSIZE, 0, SECTORSIZE);
+		// Munmap Waits for busy, Yet the Mapping Must Still Be There
+		if(FindMapping(proc, page) != map){
+			free(kbuf);
+			ReleaseKill();
+			return 0;
+		}
 	}
-	int startPage = (int)(ptr - VMEM_1_BASE) >> PAGESHIFT;
-	int endPage = (int)(ptr - VMEM_1_BASE + length - 1) >> PAGESHIFT;
-	TracePrintf(3, "Validating Ptr %p with Length %d\n", ptr, length);
-	int page = startPage;
+	CopyToPageTable(proc->pageTableR1, addr, kbuf, PAGESIZE);
+	free(kbuf);
+	proc->pageTableR1[page].prot = PROT_READ;
+	map->state[page - map->startPage] = MAP_CLEAN;
+	WriteRegister(REG_TLB_FLUSH, (unsigned int)addr);
+	MmapDone(map);
+	ReleaseKill();
+	return 0;
+}
+
+
+// Fault in the mapped pages of [ptr, ptr + length) of the process proc, and dirty them for PROT_WRITE,
+// so the access is allowed as it would be to the user
+// Return 1 after blocking once, as proc may be gone, 0 when no blocking was needed
+static int MmapPrepare(UserContext *uctxt, PCB *proc, void *ptr, int length, int prot)
+{
+	Mapping *map;
+	int page, endPage;
+	if(length <= 0 || (int)ptr < VMEM_1_BASE || (int)ptr >= VMEM_1_LIMIT || length > VMEM_1_LIMIT - (int)ptr)
+		return 0;
+	page = (int)(ptr - VMEM_1_BASE) >> PAGESHIFT;
+	endPage = (int)(ptr - VMEM_1_BASE + length - 1) >> PAGESHIFT;
 	for(; page <= endPage; page++){
-		if(curProc->pageTableR1[page].valid == 0 || (curProc->pageTableR1[page].prot & prot) != prot){
-			TracePrintf(0, "ValidatePtr: C-style String in Invalid Page\n");
-			return -1;
+		map = FindMapping(proc, page);
+		if(map == NULL)
+			continue;
+		// Out of Memory, the Page Stays Absent and the Access Is Refused
+		if(map->state[page - map->startPage] == MAP_ABSENT){
+			if(MmapFault(uctxt, proc, map, page) == -1)
+				return 0;
+			return 1;
+		}else if(map->state[page - map->startPage] == MAP_LOADING){
+			HoldKill();
+			SwitchContext(uctxt, &map->waitQueue);
+			ReleaseKill();
+			return 1;
+		}else if(map->state[page - map->startPage] == MAP_CLEAN && (prot & PROT_WRITE)){
+			map->state[page - map->startPage] = MAP_DIRTY;
+			proc->pageTableR1[page].prot = PROT_READ | PROT_WRITE;
+			WriteRegister(REG_TLB_FLUSH, VMEM_1_BASE + (page << PAGESHIFT));
 		}
 	}
 	return 0;
 }
 
 
-static int ValidateCStyle(void *ptr, int type)
+// ValidatePtr, after faulting in the mapped pages of the range
+static int UserPtr(UserContext *uctxt, void *ptr, int length, int prot)
+{
+	while(MmapPrepare(uctxt, GroupOf(curProc), ptr, length, prot) == 1);
+	return ValidatePtr(ptr, length, prot);
+}
+
+
+// Wait out loads and write back until the mapping at page is idle and clean
+// Return it, to be freed before blocking again, or NULL if it is gone
+static Mapping *MmapSettle(UserContext *uctxt, int page)
 {
+	Mapping *map;
+	int result;
+	while((map = FindMapping(GroupOf(curProc), page)) != NULL){
+		if(map->busy > 0){
+			HoldKill();
+			result = SwitchContext(uctxt, &map->waitQueue);
+			ReleaseKill();
+			if(result == -1)
+				return NULL;
+		}else if(MmapDirty(map))
+			MmapFlush(uctxt, map);
+		else
+			return map;
+	}
+	return NULL;
+}
+
+
+// Whether any page of the mapping has to be written back
+static int MmapDirty(Mapping *map)
+{
+	int p;
+	for(p = 0; p < map->npg; p++){
+		if(map->state[p] == MAP_DIRTY)
+			return 1;
+	}
+	return 0;
+}
+
+
+// Write the dirty pages of the mapping back to their sectors
+static void MmapFlush(UserContext *uctxt, Mapping *map)
+{
+	int p, i;
+	HoldKill();
+	map->busy++;
+	for(p = 0; p < map->npg; p++){
+		if(map->state[p] != MAP_DIRTY)
+			continue;
+		void *addr = (void *)(VMEM_1_BASE + ((map->startPage + p) << PAGESHIFT));
+		int *sectors = &map->sectors[p * SECTORS_PER_PAGE];
+		for(i = 0; i < SECTORS_PER_PAGE; i++)
+			if(sectors[i] != 0)
+				SectorIO(uctxt, 0, sectors[i], addr + i * SECTORSIZE);
+		map->state[p] = MAP_CLEAN;
+		curProc->pageTableR1[map->startPage + p].prot = PROT_READ;
+	}
+	WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+	MmapDone(map);
+	ReleaseKill();
+}
+
+
+// End one load or flush of the mapping and wake the threads waiting on it
+static void MmapDone(Mapping *map)
+{
+	PCB *pcb;
+	map->busy--;
+	while((pcb = pop(&map->waitQueue)) != NULL)
+		WakePCB(pcb);
+}
+
+
+// Write back and drop every mapping of curProc before exit
+static void UnmapAll(UserContext *uctxt)
+{
+	while(curProc->mappings.head != NULL){
+		Mapping *map = curProc->mappings.head->content;
+		map = MmapSettle(uctxt, map->startPage);
+		if(map != NULL)
+			FreeMapping(curProc, map);
+	}
+}
+
+
+// Move one sector between buf and the buffer cache, blocking on transfers
+static int CachedTransfer(UserContext *uctxt, int read, int sector, void *buf)
+{
+	unsigned int start = tickCount;
+	int result, retry = 0;
 	while(1){
-		int result = ValidatePtr(ptr, type, PROT_READ);
+		if(read)
+			result = BcacheRead(sector, buf, retry);
+		else
+			result = BcacheWrite(sector, buf);
+		if(result != BCACHE_BLOCK)
+			break;
+		SwitchContext(uctxt, NULL);
+		retry = 1;
+		// Another Thread May Have Unmapped buf Meanwhile
+		if(SectorBufGone(buf, read))
+			return ERROR;
+	}
+	if(result == BCACHE_ERROR)
+		return ERROR;
+	if(read){
+		unsigned int latency = tickCount - start;
+		bcacheStats.reads++;
+		bcacheStats.readTicks += latency;
+		if(latency > bcacheStats.maxReadTicks)
+			bcacheStats.maxReadTicks = latency;
+	}
+	return 0;
+}
+
+
+// Write back the buffer cache, blocking until the disk has every dirty sector
+static int CachedSync(UserContext *uctxt)
+{
+	int result;
+	while((result = BcacheSync()) == BCACHE_BLOCK)
+		SwitchContext(uctxt, NULL);
+	if(result == BCACHE_ERROR)
+		return ERROR;
+	return 0;
+}
+
+
+// Block until every transmit ring is empty
+static void TtyDrain(UserContext *uctxt)
+{
+	int i;
+	for(i = 0; i < NUM_TERMINALS; i++){
+		while(txRing[i].count > 0)
+			SwitchContext(uctxt, &transBlkQueue[i]);
+	}
+}
+
+
+// Run up to n submitted calls through the handler, posting each result
+// Return the number of calls consumed
+static int RingRun(UserContext *uctxt, int n)
+{
+	Ring *ring = (Ring *)curProc->ring;
+	RingSqe *sqe;
+	RingCqe *cqe;
+	int code = uctxt->code;
+	u_long regs[GREGS];
+	int i, done = 0;
+	memcpy(regs, uctxt->regs, sizeof(regs));
+	while(done < n && ring->sqHead != ring->sqTail && ring->cqTail - ring->cqHead < RING_ENTRIES){
+		sqe = &ring->sq[ring->sqHead % RING_ENTRIES];
+		cqe = &ring->cq[ring->cqTail % RING_ENTRIES];
+		cqe->tag = sqe->tag;
+		if(RingAllowed(sqe)){
+			uctxt->code = sqe->code;
+			for(i = 0; i < 4; i++)
+				uctxt->regs[i] = sqe->args[i];
+			trap_kernel_handler(uctxt);
+			// The Call May Have Blocked While Another Thread Unmapped the Ring
+			if(UserPtr(uctxt, ring, sizeof(Ring), PROT_READ | PROT_WRITE) == -1)
+				break;
+			cqe->result = uctxt->regs[0];
+		}else
+			cqe->result = ERROR;
+		ring->sqHead++;
+		ring->cqTail++;
+		done++;
+	}
+	uctxt->code = code;
+	memcpy(uctxt->regs, regs, sizeof(regs));
+	return done;
+}
+
+
+static int RingAllowed(RingSqe *sqe)
+{
+	switch(sqe->code){
+		case YALNIX_PIPE_READ:
+		case YALNIX_PIPE_WRITE:
+		case YALNIX_LOCK_ACQUIRE:
+		case YALNIX_LOCK_RELEASE:
+		case YALNIX_CVAR_SIGNAL:
+		case YALNIX_CVAR_BROADCAST:
+		case YALNIX_TTY_READ:
+		case YALNIX_TTY_WRITE:
+		case YALNIX_DELAY:
+		case YALNIX_GETPID:
+			return 1;
+		case YALNIX_CUSTOM_0:
+			switch(CUSTOM_OP(sqe->args[0])){
+				case CUSTOM_PIPE_READ:
+				case CUSTOM_PIPE_WRITE:
+				case CUSTOM_TTY_READ:
+				case CUSTOM_RW_ACQUIRE:
+				case CUSTOM_RW_RELEASE:
+					return 1;
+			}
+	}
+	return 0;
+}
+
+
+// Block until one of fds is ready or timeout clock ticks passed
+// Return the number of ready fds, 0 on timeout
+static int PollWait(UserContext *uctxt, PollFd *fds, int n, int timeout)
+{
+	int i, ready, result;
+	while(1){
+		ready = 0;
+		for(i = 0; i < n; i++){
+			fds[i].revents = 0;
+			if(fds[i].events & POLL_TTY_IN){
+				if(fds[i].id < 0 || fds[i].id >= NUM_TERMINALS)
+					fds[i].revents |= POLL_INVALID;
+				else if(rxRing[fds[i].id].lines > 0)
+					fds[i].revents |= POLL_TTY_IN;
+			}
+			if(fds[i].events & (POLL_PIPE_IN | POLL_PIPE_OUT))
+				fds[i].revents |= KernelPipePoll(fds[i].id, fds[i].events, 0);
+			if(fds[i].revents != 0)
+				ready++;
+		}
+		if(ready > 0 || timeout == 0)
+			return ready;
+
+		// Hook into the wait list of every fd, then sleep
+		for(i = 0; i < n; i++){
+			if(fds[i].events & POLL_TTY_IN)
+				push(&ttyPollQueue[fds[i].id], curProc);
+			if(fds[i].events & (POLL_PIPE_IN | POLL_PIPE_OUT))
+				KernelPipePoll(fds[i].id, fds[i].events, 1);
+		}
+		curProc->polling = 1;
+		if(timeout > 0){
+			curProc->clockticks = timeout;
+			push(&clockQueue, curProc);
+		}
+		result = SwitchContext(uctxt, NULL);
+		curProc->polling = 0;
+		for(i = 0; i < n; i++){
+			if(fds[i].events & POLL_TTY_IN)
+				remove(&ttyPollQueue[fds[i].id], curProc);
+			if(fds[i].events & (POLL_PIPE_IN | POLL_PIPE_OUT))
+				KernelPipeUnhook(fds[i].id);
+		}
 		if(result == -1)
-			return -1;
-		if(type == sizeof(char)){
-			if(*((char *)ptr) == '\0')
-				return 0;
-			ptr = ((char *)ptr) + 1;
-		}else if(type == sizeof(char *)){
-			if(*((char **)ptr) == NULL)
-				return 0;
-			ptr = ((char **)ptr) + 1;
+			return ERROR;
+		if(timeout > 0){
+			remove(&clockQueue, curProc);
+			timeout = curProc->clockticks;
 		}
+		// Another Thread May Have Unmapped fds Meanwhile
+		if(UserPtr(uctxt, fds, n * sizeof(PollFd), PROT_READ | PROT_WRITE) == -1)
+			return ERROR;
 	}
 }
 
 
 void trap_clock_handler(UserContext *uctxt)
 {
+	TRACE(TRACE_TRAP, TRAP_CLOCK, 0);
+	tickCount++;
+	if(profMode != PROF_OFF)
+		ProfSample(uctxt);
+	if(tickCount % BCACHE_FLUSH_TICKS == 0)
+		BcacheTick();
 	// Reduce Clockticks of All Processes in Clcck Queue
 	Entry *curEntry = clockQueue.head;
 	while(curEntry != NULL){
@@ -493,7 +1720,8 @@ void trap_clock_handler(UserContext *uctxt)
 		curEntry = curEntry->next;
 		if(--pcb->clockticks == 0){
 			remove(&clockQueue, pcb);
-			push(&readyQueue, pcb);
+			pcb->polling = 0;
+			WakePCB(pcb);
 		}
 	}
 	SwitchContext(uctxt, &readyQueue);
@@ -515,7 +1743,7 @@ static int SwitchContext(UserContext *uctxt, Queue *queue)
 	PCB *next_Proc = pop(&readyQueue);
 	// When Current Proc is Dead
 	if(cur_Proc != NULL)
-		TracePrintf(3, "Cur Pid=%d, Cur sp=%p, Next sp=%p\n", cur_Proc->pid, cur_Proc->uctxt.sp, uctxt->sp);
+		KTrace(3, "Cur Pid=%d, Cur sp=%p, Next sp=%p\n", cur_Proc->pid, cur_Proc->uctxt.sp, uctxt->sp);
 	if(next_Proc == NULL)
 		next_Proc = idle;
 	if(cur_Proc != next_Proc){
@@ -524,97 +1752,125 @@ static int SwitchContext(UserContext *uctxt, Queue *queue)
 			memcpy(&cur_Proc->uctxt, uctxt, sizeof(UserContext));
 		int result = KernelContextSwitch(MyKCS, cur_Proc, next_Proc);
 		if(result != 0){
-			TracePrintf(0, "KernelContextSwitch: Error!!\n");
+			KTrace(0, "KernelContextSwitch: Error!!\n");
 			exit(1);
 		}
 		memcpy(uctxt, &cur_Proc->uctxt, sizeof(UserContext));
 	}
+	if(curProc->killed && curProc->uninterruptible == 0)
+		KernelThreadExit(KILL);
 	return 0;
 }
 
 
 void trap_illegal_handler(UserContext *uctxt)
 {
-	TracePrintf(0, "ILLEGAL TRAP: Proc %d\n", curProc->pid);
-	Die(KILL);
+	TRACE(TRACE_TRAP, TRAP_ILLEGAL, uctxt->code);
+	KTrace(0, "ILLEGAL TRAP: Proc %d\n", curProc->pid);
+	Die(uctxt, KILL);
 }
 
 
 void trap_memory_handler(UserContext *uctxt)
 {
+	TRACE(TRACE_TRAP, TRAP_MEMORY, uctxt->addr);
+	// A Thread Returned from Its Function, with Its Status in regs[0]
+	if(curProc->group != NULL && (int)uctxt->pc == THREAD_RETURN_PC)
+		KernelThreadExit(uctxt->regs[0]);
+	// Mapped File Pages Fault in on Any Access and Turn Dirty on the First Write
+	if((int)uctxt->addr >= VMEM_1_BASE && (int)uctxt->addr < VMEM_1_LIMIT){
+		int page = (int)(uctxt->addr - VMEM_1_BASE) >> PAGESHIFT;
+		Mapping *map = FindMapping(GroupOf(curProc), page);
+		if(map != NULL && map->state[page - map->startPage] == MAP_ABSENT){
+			if(MmapFault(uctxt, GroupOf(curProc), map, page) == -1){
+				KTrace(0, "MEMORY TRAP: No Enough Memory to Load Proc %d, Addr %p\n", curProc->pid, uctxt->addr);
+				Die(uctxt, KILL);
+			}
+			return;
+		}else if(map != NULL && map->state[page - map->startPage] == MAP_LOADING){
+			// Another Thread Is Loading the Page, Retry the Access Once It Is in
+			HoldKill();
+			SwitchContext(uctxt, &map->waitQueue);
+			ReleaseKill();
+			return;
+		}else if(map != NULL && map->state[page - map->startPage] == MAP_CLEAN){
+			map->state[page - map->startPage] = MAP_DIRTY;
+			curProc->pageTableR1[page].prot = PROT_READ | PROT_WRITE;
+			WriteRegister(REG_TLB_FLUSH, (unsigned int)DOWN_TO_PAGE(uctxt->addr));
+			return;
+		}
+	}
 	if(uctxt->code == YALNIX_MAPERR){
 		void *addr = (void *)DOWN_TO_PAGE(uctxt->addr);
-		if(curProc->brkR1 < addr && addr < curProc->stackR1){
+		// Thread Stacks Don't Grow
+		if(curProc->group == NULL && curProc->brkR1 < addr && addr < curProc->stackR1){
 			int startPage = (int)(addr - VMEM_1_BASE) >> PAGESHIFT;
 			int count = (curProc->stackR1 - addr) / PAGESIZE;
+			if(!PageRangeFree(curProc->pageTableR1, startPage, count)){
+				KTrace(0, "MEMORY TRAP: Stack Runs into Shared Memory Proc %d, Addr %p\n", curProc->pid, uctxt->addr);
+				Die(uctxt, KILL);
+			}
 			int result = AllocPageFrame(curProc->pageTableR1, startPage, count, PROT_READ | PROT_WRITE);
 			if(result == -1){
-				TracePrintf(0, "MEMORY TRAP: No Enough Memory Proc %d, Addr %p", curProc->pid, uctxt->addr);
-				Die(KILL);
+				KTrace(0, "MEMORY TRAP: No Enough Memory Proc %d, Addr %p", curProc->pid, uctxt->addr);
+				Die(uctxt, KILL);
 			}
 			curProc->stackR1 = addr;
 		}else{
-			TracePrintf(0, "MEMORY TRAP: Invalid Access Proc %d, Addr %p\n", curProc->pid, uctxt->addr);
-			Die(KILL);
+			KTrace(0, "MEMORY TRAP: Invalid Access Proc %d, Addr %p\n", curProc->pid, uctxt->addr);
+			Die(uctxt, KILL);
 		}
 	}else
-		Die(KILL);
+		Die(uctxt, KILL);
 }
 
 
 void trap_math_handler(UserContext *uctxt)
 {
-	TracePrintf(0, "MATH TRAP: Proc %d\n", curProc->pid);
-	Die(KILL);
+	TRACE(TRACE_TRAP, TRAP_MATH, uctxt->code);
+	KTrace(0, "MATH TRAP: Proc %d\n", curProc->pid);
+	Die(uctxt, KILL);
 }
 
 
 void trap_tty_rev_handler(UserContext *uctxt)
 {
 	int tty_id = uctxt->code;
-	int count = TtyReceive(tty_id, ttyReceive, TERMINAL_MAX_LINE);
-	Block *block = (Block *)malloc(sizeof(Block));
-	if(block != NULL){
-		char *buf;
-		if(count == 0)
-			buf = NULL;
-		else if(count > 0){
-			TracePrintf(0, "count = %d\n", count);
-			buf = (char *)malloc(count);
-			if(buf == NULL){
-				free(block);
-				return;
-			}
-			memcpy(buf, ttyReceive, count);
-		}
-		block->count = count;
-		block->buf = buf;
-		block->ptr = buf;
-		int result = push(&revQueue[tty_id], block);
-		if(result == -1){
-			if(buf != NULL)
-				free(buf);
-			free(block);
-			return;
-		}
+	TRACE(TRACE_TTY_RX, tty_id, 0);
+	if(TtyReceiveLine(tty_id)){
+		// Hand the line to blocked readers, waking one reader per piece of it
 		PCB *pcb;
-		while((pcb = pop(&revBlkQueue[tty_id])) != NULL)
-			push(&readyQueue, pcb);
+		while(rxRing[tty_id].lines > 0 && (pcb = pop(&revBlkQueue[tty_id])) != NULL){
+			// The Reader's buf May Have Been Unmapped by Another of Its Threads
+			if(PageRangeValid(pcb->pageTableR1, pcb->ttyBuf, pcb->ttyLen, PROT_READ | PROT_WRITE))
+				pcb->ttyCount = TtyReadLine(tty_id, pcb->ttyBuf, pcb->ttyLen, pcb->pageTableR1);
+			else
+				pcb->ttyCount = ERROR;
+			pcb->handoff = 1;
+			WakePCB(pcb);
+		}
+		if(rxRing[tty_id].lines > 0)
+			WakePollers(&ttyPollQueue[tty_id]);
 	}
 }
 
 
 void trap_tty_trans_handler(UserContext *uctxt)
 {
-	int tty_id = uctxt->code;
-	transReady[tty_id] = 1;
-	PCB *pcb;
-	while((pcb = pop(&transBlkQueue[tty_id])) != NULL)
-		push(&readyQueue, pcb);
+	TRACE(TRACE_TTY_TX, uctxt->code, 0);
+	TtyTransmitDone(uctxt->code);
+}
+
+
+void trap_disk_handler(UserContext *uctxt)
+{
+	TRACE(TRACE_TRAP, TRAP_DISK, 0);
+	DiskInterrupt();
 }
 
 
 void trap_dummy_handler(UserContext *uctxt)
 {
-	TracePrintf(0, "DUMMY TRAP: Unspecified Trap %d\n", uctxt->vector);
+	TRACE(TRACE_TRAP, uctxt->vector, uctxt->code);
+	KTrace(0, "DUMMY TRAP: Unspecified Trap %d\n", uctxt->vector);
 }
@@ -1,16 +1,21 @@
+#include "../include/custom.h"
 #include "../include/hardware.h"
 #include "../include/IPC.h"
+#include "../include/mm.h"
 #include "../include/PCB.h"
 #include "../include/queue.h"
+#include "../include/trace.h"
 #include "../include/yalnix.h"
 
 // Pipe Lock or Condition Variable's Id 
 static int id = 0;
 Queue ipcQueue;
 extern Queue readyQueue;
+extern Queue clockQueue;
 extern void *curProc;
 static IPC *createIPC(Type, void *);
 static void destroyIPC(int);
+static int ShmDetach(IPC *, void *);
 
 void InitIPC(void)
 {
@@ -22,23 +27,24 @@ int KernelPipeInit(int *pipe_id)
 {
 	Pipe *pipe = (Pipe *)malloc(sizeof(Pipe));
 	if(pipe == NULL){
-		TracePrintf(0, "KernelPipeInit: Pipe Init Failed\n");
+		KTrace(0, "KernelPipeInit: Pipe Init Failed\n");
 		return IPC_ERROR;
 	}
 	pipe->read_ptr = pipe->write_ptr = pipe->buf;
 	pipe->readQueue.head = pipe->readQueue.tail = NULL;
 	pipe->writeQueue.head = pipe->writeQueue.tail = NULL;
+	pipe->pollQueue.head = pipe->pollQueue.tail = NULL;
 	IPC *ipc = createIPC(PIPE, pipe);
 	if(ipc == NULL){
 		free(pipe);
-		TracePrintf(0, "KernelPipeInit: Pipe(IPC) Init Failed\n");
+		KTrace(0, "KernelPipeInit: Pipe(IPC) Init Failed\n");
 		return IPC_ERROR;
 	}
 	int result = push(&ipcQueue, ipc);
 	if(result == -1){
 		free(ipc);
 		free(pipe);
-		TracePrintf(0, "KernelPipeInit: Pipe(Push) Init Failed\n");
+		KTrace(0, "KernelPipeInit: Pipe(Push) Init Failed\n");
 		return IPC_ERROR;
 	}
 	*pipe_id = ipc->id;
@@ -47,8 +53,8 @@ int KernelPipeInit(int *pipe_id)
 
 
 // Read until satisfied or empty (pipe->read_ptr == pipe->write_ptr)
-// Put curProc into pipe->readQueue if not satisfied
-int KernelPipeRead(int pipe_id, void *buf, int len)
+// Put curProc into pipe->readQueue if less than min bytes are read
+int KernelPipeRead(int pipe_id, void *buf, int len, int min)
 {
 	Pipe *pipe = NULL;
 	foreach(entry, &ipcQueue){
@@ -59,7 +65,7 @@ int KernelPipeRead(int pipe_id, void *buf, int len)
 		}
 	}
 	if(pipe == NULL){
-		TracePrintf(0, "KernelPipeRead: Pipe %d Does Not Exist\n", pipe_id);
+		KTrace(0, "KernelPipeRead: Pipe %d Does Not Exist\n", pipe_id);
 		return IPC_ERROR;
 	}
 	int retVal = 0;
@@ -85,9 +91,11 @@ int KernelPipeRead(int pipe_id, void *buf, int len)
 		int frontLen = pipe->write_ptr - pipe->read_ptr;
 		if(len > frontLen){
 			len = frontLen;
-			int result = push(&pipe->readQueue, curProc);
-			if(result == -1)
-				return IPC_ERROR;
+			if(retVal + len < min){
+				int result = push(&pipe->readQueue, curProc);
+				if(result == -1)
+					return IPC_ERROR;
+			}
 		}
 		retVal += len;
 		memcpy(buf, pipe->read_ptr, len);
@@ -95,14 +103,15 @@ int KernelPipeRead(int pipe_id, void *buf, int len)
 	}
 	void *pcb;
 	while((pcb = pop(&pipe->writeQueue)) != NULL)
-		push(&readyQueue, pcb);
+		WakePCB(pcb);
+	WakePollers(&pipe->pollQueue);
 	return retVal;
 }
 
 
 // Write until satisfied or empty (pipe->read_ptr == (pipe->write_ptr + 1) or pipe->read_ptr and pipe->write_ptr stand at two ends)
-// Put curProc into pipe->writeQueue if not satisfied
-int KernelPipeWrite(int pipe_id, void *buf, int len)
+// Put curProc into pipe->writeQueue if less than min bytes are written
+int KernelPipeWrite(int pipe_id, void *buf, int len, int min)
 {
 	Pipe *pipe = NULL;
 	foreach(entry, &ipcQueue){
@@ -113,7 +122,7 @@ int KernelPipeWrite(int pipe_id, void *buf, int len)
 		}
 	}
 	if(pipe == NULL){
-		TracePrintf(0, "KernelPipeWrite: Pipe %d Does Not Exist\n", pipe_id);
+		KTrace(0, "KernelPipeWrite: Pipe %d Does Not Exist\n", pipe_id);
 		return IPC_ERROR;
 	}
 	int retVal = 0;
@@ -139,7 +148,7 @@ int KernelPipeWrite(int pipe_id, void *buf, int len)
 			pipe->write_ptr += backLen;
 			if(!over)
 				pipe->write_ptr = pipe->buf;
-			else{
+			else if(retVal < min){
 				int result = push(&pipe->writeQueue, curProc);
 				if(result == -1)
 					return IPC_ERROR;
@@ -150,9 +159,11 @@ int KernelPipeWrite(int pipe_id, void *buf, int len)
 		int frontLen = pipe->read_ptr - pipe->write_ptr - 1;
 		if(len > frontLen){
 			len = frontLen;
-			int result = push(&pipe->writeQueue, curProc);
-			if(result == -1)
-				return IPC_ERROR;
+			if(retVal + len < min){
+				int result = push(&pipe->writeQueue, curProc);
+				if(result == -1)
+					return IPC_ERROR;
+			}
 		}
 		retVal += len;
 		memcpy(pipe->write_ptr, buf, len);
@@ -160,16 +171,73 @@ int KernelPipeWrite(int pipe_id, void *buf, int len)
 	}
 	void *pcb;
 	while((pcb = pop(&pipe->readQueue)) != NULL)
-		push(&readyQueue, pcb);
+		WakePCB(pcb);
+	WakePollers(&pipe->pollQueue);
 	return retVal;
 }
 
 
+// Return the ready events of the pipe
+// Hook curProc into pipe->pollQueue if nothing is ready and hook is set
+int KernelPipePoll(int pipe_id, int events, int hook)
+{
+	Pipe *pipe = NULL;
+	foreach(entry, &ipcQueue){
+		IPC *ipc = (IPC *)entry->content;
+		if(ipc->id == pipe_id && ipc->type == PIPE){
+			pipe = (Pipe *)ipc->content;
+			break;
+		}
+	}
+	if(pipe == NULL)
+		return POLL_INVALID;
+	int used = (pipe->write_ptr - pipe->read_ptr + PIPE_LEN) % PIPE_LEN;
+	int revents = 0;
+	if((events & POLL_PIPE_IN) && used > 0)
+		revents |= POLL_PIPE_IN;
+	if((events & POLL_PIPE_OUT) && used < PIPE_LEN - 1)
+		revents |= POLL_PIPE_OUT;
+	if(revents == 0 && hook){
+		int result = push(&pipe->pollQueue, curProc);
+		if(result == -1)
+			return IPC_ERROR;
+	}
+	return revents;
+}
+
+
+void KernelPipeUnhook(int pipe_id)
+{
+	foreach(entry, &ipcQueue){
+		IPC *ipc = (IPC *)entry->content;
+		if(ipc->id == pipe_id && ipc->type == PIPE){
+			remove(&((Pipe *)ipc->content)->pollQueue, curProc);
+			break;
+		}
+	}
+}
+
+
+// Wake up every poller sleeping on the queue
+// A poller hooks into several queues, only the first wakeup counts
+void WakePollers(Queue *queue)
+{
+	PCB *pcb;
+	while((pcb = pop(queue)) != NULL){
+		if(pcb->polling){
+			pcb->polling = 0;
+			remove(&clockQueue, pcb);
+			WakePCB(pcb);
+		}
+	}
+}
+
+
 int KernelLockInit(int *lock_id)
 {
 	Lock *lock = (Lock *)malloc(sizeof(Lock));
 	if(lock == NULL){
-		TracePrintf(0, "KernelLockInit: Lock Init Failed\n");
+		KTrace(0, "KernelLockInit: Lock Init Failed\n");
 		return IPC_ERROR;
 	}
 	lock->locking = 0;
@@ -177,14 +245,14 @@ int KernelLockInit(int *lock_id)
 	IPC *ipc = createIPC(LOCK, lock);
 	if(ipc == NULL){
 		free(lock);
-		TracePrintf(0, "KernelLockInit: Lock(IPC) Init Failed\n");
+		KTrace(0, "KernelLockInit: Lock(IPC) Init Failed\n");
 		return IPC_ERROR;
 	}
 	int result = push(&ipcQueue, ipc);
 	if(result == -1){
 		free(ipc);
 		free(lock);
-		TracePrintf(0, "KernelLockInit: Lock(Push) Init Failed\n");
+		KTrace(0, "KernelLockInit: Lock(Push) Init Failed\n");
 		return IPC_ERROR;
 	}
 	*lock_id = ipc->id;
@@ -203,17 +271,17 @@ int KernelAcquire(int lock_id)
 		}
 	}
 	if(lock == NULL){
-		TracePrintf(0, "KernelAcquire: Lock %d Does Not Exist\n", lock_id);
+		KTrace(0, "KernelAcquire: Lock %d Does Not Exist\n", lock_id);
 		return IPC_ERROR;
 	}
 	if(lock->locking){
-		TracePrintf(0, "KernelAcquire: Lock %d Is Locked By Proc %d\n", lock_id, ((PCB *)lock->lockProc)->pid);
+		KTrace(0, "KernelAcquire: Lock %d Is Locked By Proc %d\n", lock_id, ((PCB *)lock->lockProc)->pid);
 		int result = push(&lock->lockQueue, curProc);
 		if(result == -1)
 			return IPC_ERROR;
 		return IPC_BLOCK;
 	}
-	TracePrintf(2, "KernelAcquire: Lock Obtained By Proc %d\n", ((PCB *)curProc)->pid);
+	KTrace(2, "KernelAcquire: Lock Obtained By Proc %d\n", ((PCB *)curProc)->pid);
 	lock->locking = 1;
 	lock->lockProc = curProc;
 	return 0;
@@ -231,7 +299,7 @@ int KernelRelease(int lock_id)
 		}
 	}
 	if(lock == NULL){
-		TracePrintf(0, "KernelRelease: Lock %d Does Not Exist\n", lock_id);
+		KTrace(0, "KernelRelease: Lock %d Does Not Exist\n", lock_id);
 		return IPC_ERROR;
 	}
 	if(lock->locking){
@@ -240,15 +308,15 @@ int KernelRelease(int lock_id)
 			lock->lockProc = NULL;
 			void *pcb;
 			while((pcb = pop(&lock->lockQueue)) != NULL)
-				push(&readyQueue, pcb);
-			TracePrintf(2, "KernelRelease: Lock Released By Proc %d\n", ((PCB *)curProc)->pid);
+				WakePCB(pcb);
+			KTrace(2, "KernelRelease: Lock Released By Proc %d\n", ((PCB *)curProc)->pid);
 			return 0;
 		}else{
-			TracePrintf(0, "KernelRelease: Lock %d Is Locked By Proc %d\n", lock_id, ((PCB *)curProc)->pid);
+			KTrace(0, "KernelRelease: Lock %d Is Locked By Proc %d\n", lock_id, ((PCB *)curProc)->pid);
 			return IPC_ERROR;
 		}
 	}else{
-		TracePrintf(0, "KernelRelease: Lock %d Isn't Locked\n", lock_id);
+		KTrace(0, "KernelRelease: Lock %d Isn't Locked\n", lock_id);
 		return 0;
 	}
 }
@@ -258,21 +326,21 @@ int KernelCvarInit(int *cvar_id)
 {
 	Cond *cond = (Cond *)malloc(sizeof(Cond));
 	if(cond == NULL){
-		TracePrintf(0, "KernelCvarInit: Cond Init Failed\n");
+		KTrace(0, "KernelCvarInit: Cond Init Failed\n");
 		return IPC_ERROR;
 	}
 	cond->waitQueue.head = cond->waitQueue.tail = NULL;
 	IPC *ipc = createIPC(COND, cond);
 	if(ipc == NULL){
 		free(cond);
-		TracePrintf(0, "KernelCvarInit: Cond(IPC) Init Failed\n");
+		KTrace(0, "KernelCvarInit: Cond(IPC) Init Failed\n");
 		return IPC_ERROR;
 	}
 	int result = push(&ipcQueue, ipc);
 	if(result == -1){
 		free(cond);
 		free(ipc);
-		TracePrintf(0, "KernelCvarInit: Cond(Push) Init Failed\n");
+		KTrace(0, "KernelCvarInit: Cond(Push) Init Failed\n");
 		return IPC_ERROR;
 	}
 	*cvar_id = ipc->id;
@@ -291,13 +359,13 @@ int KernelCvarNotify(int cvar_id, int type)
 		}
 	}
 	if(cond == NULL){
-		TracePrintf(0, "KernelCvarSignal: Cond %d Does Not Exist\n", cvar_id);
+		KTrace(0, "KernelCvarSignal: Cond %d Does Not Exist\n", cvar_id);
 		return IPC_ERROR;
 	}
 	void *pcb = NULL;
 	do{
 		if((pcb = pop(&cond->waitQueue)) != NULL)
-			push(&readyQueue, pcb);
+			WakePCB(pcb);
 	}while(type == YALNIX_CVAR_BROADCAST && pcb != NULL);
 	return 0;
 }
@@ -315,7 +383,7 @@ int KernelWait(int cvar_id, int lock_id)
 		}
 	}
 	if(cond == NULL){
-		TracePrintf(0, "KernelWait: Either Cvar %d Does Not Exist\n", cvar_id);
+		KTrace(0, "KernelWait: Either Cvar %d Does Not Exist\n", cvar_id);
 		return IPC_ERROR;
 	}
 	int result = KernelRelease(lock_id); 
@@ -328,36 +396,330 @@ int KernelWait(int cvar_id, int lock_id)
 }
 
 
+int KernelRWLockInit(int *rwlock_id)
+{
+	RWLock *rwlock = (RWLock *)malloc(sizeof(RWLock));
+	if(rwlock == NULL){
+		KTrace(0, "KernelRWLockInit: RWLock Init Failed\n");
+		return IPC_ERROR;
+	}
+	rwlock->readers.head = rwlock->readers.tail = NULL;
+	rwlock->writer = NULL;
+	rwlock->readQueue.head = rwlock->readQueue.tail = NULL;
+	rwlock->writeQueue.head = rwlock->writeQueue.tail = NULL;
+	IPC *ipc = createIPC(RWLOCK, rwlock);
+	if(ipc == NULL){
+		free(rwlock);
+		KTrace(0, "KernelRWLockInit: RWLock(IPC) Init Failed\n");
+		return IPC_ERROR;
+	}
+	int result = push(&ipcQueue, ipc);
+	if(result == -1){
+		free(ipc);
+		free(rwlock);
+		KTrace(0, "KernelRWLockInit: RWLock(Push) Init Failed\n");
+		return IPC_ERROR;
+	}
+	*rwlock_id = ipc->id;
+	return 0;
+}
+
+
+// Readers share the lock unless a writer holds it or waits for it
+// A blocked caller owns the lock when woken with pcb->handoff set
+int KernelRWAcquire(int rwlock_id, int exclusive)
+{
+	RWLock *rwlock = NULL;
+	foreach(entry, &ipcQueue){
+		IPC *ipc = (IPC *)entry->content;
+		if(ipc->id == rwlock_id && ipc->type == RWLOCK){
+			rwlock = (RWLock *)ipc->content;
+			break;
+		}
+	}
+	if(rwlock == NULL){
+		KTrace(0, "KernelRWAcquire: RWLock %d Does Not Exist\n", rwlock_id);
+		return IPC_ERROR;
+	}
+	int result;
+	if(exclusive){
+		if(rwlock->writer == NULL && rwlock->readers.head == NULL){
+			rwlock->writer = curProc;
+			return 0;
+		}
+		result = push(&rwlock->writeQueue, curProc);
+	}else{
+		if(rwlock->writer == NULL && rwlock->writeQueue.head == NULL){
+			if(push(&rwlock->readers, curProc) == -1)
+				return IPC_ERROR;
+			return 0;
+		}
+		result = push(&rwlock->readQueue, curProc);
+	}
+	if(result == -1)
+		return IPC_ERROR;
+	return IPC_BLOCK;
+}
+
+
+// A leaving writer hands the lock to all pending readers in one pass,
+// or to the next writer; the last leaving reader hands it to the next writer
+int KernelRWRelease(int rwlock_id)
+{
+	RWLock *rwlock = NULL;
+	foreach(entry, &ipcQueue){
+		IPC *ipc = (IPC *)entry->content;
+		if(ipc->id == rwlock_id && ipc->type == RWLOCK){
+			rwlock = (RWLock *)ipc->content;
+			break;
+		}
+	}
+	if(rwlock == NULL){
+		KTrace(0, "KernelRWRelease: RWLock %d Does Not Exist\n", rwlock_id);
+		return IPC_ERROR;
+	}
+	int wasWriter = (rwlock->writer == curProc);
+	int wasReader = 0;
+	foreach(holder, &rwlock->readers){
+		if(holder->content == curProc)
+			wasReader = 1;
+	}
+	if(wasWriter)
+		rwlock->writer = NULL;
+	else if(wasReader)
+		remove(&rwlock->readers, curProc);
+	else{
+		KTrace(0, "KernelRWRelease: RWLock %d Isn't Held By Proc %d\n", rwlock_id, ((PCB *)curProc)->pid);
+		return IPC_ERROR;
+	}
+	if(rwlock->readers.head != NULL)
+		return 0;
+	PCB *pcb;
+	if(rwlock->readQueue.head != NULL && (wasWriter || rwlock->writeQueue.head == NULL)){
+		// A Reader Left Blocked for Want of Memory Gets the Lock on a Later Release
+		while(rwlock->readQueue.head != NULL){
+			pcb = rwlock->readQueue.head->content;
+			if(push(&rwlock->readers, pcb) == -1)
+				break;
+			pop(&rwlock->readQueue);
+			pcb->handoff = 1;
+			WakePCB(pcb);
+		}
+	}else if((pcb = pop(&rwlock->writeQueue)) != NULL){
+		rwlock->writer = pcb;
+		pcb->handoff = 1;
+		WakePCB(pcb);
+	}
+	return 0;
+}
+
+
+// Create a shared memory segment of size bytes and map it into curProc
+// Return the mapped address
+int KernelShmInit(int *shm_id, int size)
+{
+	if(size <= 0)
+		return IPC_ERROR;
+	Shm *shm = (Shm *)malloc(sizeof(Shm));
+	if(shm == NULL){
+		KTrace(0, "KernelShmInit: Shm Init Failed\n");
+		return IPC_ERROR;
+	}
+	shm->npg = UP_TO_PAGE(size) >> PAGESHIFT;
+	shm->mappers = 0;
+	shm->mapQueue.head = shm->mapQueue.tail = NULL;
+	shm->frames = (struct pte *)malloc(shm->npg * sizeof(struct pte));
+	if(shm->frames == NULL){
+		free(shm);
+		KTrace(0, "KernelShmInit: Shm(Frames) Init Failed\n");
+		return IPC_ERROR;
+	}
+	int result = AllocPageFrame(shm->frames, 0, shm->npg, PROT_READ | PROT_WRITE);
+	if(result == -1){
+		free(shm->frames);
+		free(shm);
+		KTrace(0, "KernelShmInit: No Enough Physical Memory\n");
+		return IPC_ERROR;
+	}
+	ZeroPageFrame(shm->frames, 0, shm->npg);
+	IPC *ipc = createIPC(SHM, shm);
+	if(ipc == NULL || push(&ipcQueue, ipc) == -1){
+		if(ipc != NULL)
+			free(ipc);
+		DeallocPageFrame(shm->frames, 0, shm->npg);
+		free(shm->frames);
+		free(shm);
+		KTrace(0, "KernelShmInit: Shm(IPC) Init Failed\n");
+		return IPC_ERROR;
+	}
+	*shm_id = ipc->id;
+	result = KernelShmAttach(ipc->id);
+	if(result == IPC_ERROR){
+		remove(&ipcQueue, ipc);
+		free(ipc);
+		DeallocPageFrame(shm->frames, 0, shm->npg);
+		free(shm->frames);
+		free(shm);
+	}
+	return result;
+}
+
+
+// Map the segment into the highest free pages between brk and stack of curProc's process
+// Return the mapped address
+int KernelShmAttach(int shm_id)
+{
+	Shm *shm = NULL;
+	foreach(entry, &ipcQueue){
+		IPC *ipc = (IPC *)entry->content;
+		if(ipc->id == shm_id && ipc->type == SHM){
+			shm = (Shm *)ipc->content;
+			break;
+		}
+	}
+	if(shm == NULL){
+		KTrace(0, "KernelShmAttach: Shm %d Does Not Exist\n", shm_id);
+		return IPC_ERROR;
+	}
+	PCB *proc = GroupOf(curProc);
+	ShmMap *map = (ShmMap *)malloc(sizeof(ShmMap));
+	if(map == NULL)
+		return IPC_ERROR;
+	int lowPage = ((int)(proc->brkR1 - VMEM_1_BASE) >> PAGESHIFT) + 1;
+	int highPage = ((int)(proc->stackR1 - VMEM_1_BASE) >> PAGESHIFT) - SHM_STACK_GAP;
+	int startPage = FindFreePages(proc->pageTableR1, lowPage, highPage, shm->npg);
+	if(startPage == -1 || push(&shm->mapQueue, map) == -1){
+		KTrace(0, "KernelShmAttach: No Room for Shm %d in Proc %d\n", shm_id, proc->pid);
+		free(map);
+		return IPC_ERROR;
+	}
+	map->proc = proc;
+	map->startPage = startPage;
+	memcpy(&proc->pageTableR1[startPage], shm->frames, shm->npg * sizeof(struct pte));
+	SharePageFrame(proc->pageTableR1, startPage, shm->npg);
+	shm->mappers++;
+	WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+	return (startPage << PAGESHIFT) + VMEM_1_BASE;
+}
+
+
+// The forked child maps the same segments at the same pages
+// Frame references are taken by the page table copy in FORK
+void KernelShmFork(void *parent, void *child)
+{
+	foreach(entry, &ipcQueue){
+		IPC *ipc = (IPC *)entry->content;
+		if(ipc->type != SHM)
+			continue;
+		Shm *shm = (Shm *)ipc->content;
+		foreach(mapEntry, &shm->mapQueue){
+			ShmMap *map = (ShmMap *)mapEntry->content;
+			if(map->proc != parent)
+				continue;
+			ShmMap *childMap = (ShmMap *)malloc(sizeof(ShmMap));
+			if(childMap == NULL)
+				continue;
+			childMap->proc = child;
+			childMap->startPage = map->startPage;
+			if(push(&shm->mapQueue, childMap) == -1){
+				free(childMap);
+				continue;
+			}
+			shm->mappers++;
+		}
+	}
+}
+
+
+// Unmap every segment of proc before its region 1 is torn down
+void KernelShmDetachAll(void *proc)
+{
+	Entry *entry = ipcQueue.head;
+	while(entry != NULL){
+		IPC *ipc = (IPC *)entry->content;
+		entry = entry->next;
+		if(ipc->type == SHM)
+			while(ShmDetach(ipc, proc) == 0);
+	}
+}
+
+
+// Unmap one mapping of the segment from proc, free the segment with its last mapper
+// Return -1 if proc does not map it
+static int ShmDetach(IPC *ipc, void *proc)
+{
+	Shm *shm = (Shm *)ipc->content;
+	ShmMap *map = NULL;
+	foreach(entry, &shm->mapQueue){
+		if(((ShmMap *)entry->content)->proc == proc){
+			map = (ShmMap *)entry->content;
+			break;
+		}
+	}
+	if(map == NULL)
+		return -1;
+	DeallocPageFrame(((PCB *)proc)->pageTableR1, map->startPage, shm->npg);
+	if(proc == GroupOf(curProc))
+		WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+	remove(&shm->mapQueue, map);
+	free(map);
+	if(--shm->mappers == 0){
+		KTrace(2, "ShmDetach: Shm %d Released\n", ipc->id);
+		DeallocPageFrame(shm->frames, 0, shm->npg);
+		free(shm->frames);
+		remove(&ipcQueue, ipc);
+		free(ipc->content);
+		free(ipc);
+	}
+	return 0;
+}
+
+
 void KernelReclaim(int ipc_id)
 {
 	Pipe *pipe;
 	Lock *lock;
 	Cond *cond;
+	RWLock *rwlock;
 	void *pcb;
 	foreach(entry, &ipcQueue){
 		IPC *ipc = entry->content;
 		if(ipc->id == ipc_id){
+			// Shared Memory Lives until Its Last Mapper Is Gone
+			if(ipc->type == SHM){
+				ShmDetach(ipc, GroupOf(curProc));
+				break;
+			}
 			switch(ipc->type){
 				case PIPE:
 					pipe = (Pipe *)ipc->content;
 					while((pcb = pop(&pipe->readQueue)) != NULL)
-						push(&readyQueue, pcb);
+						WakePCB(pcb);
 					while((pcb = pop(&pipe->writeQueue)) != NULL)
-						push(&readyQueue, pcb);
+						WakePCB(pcb);
+					WakePollers(&pipe->pollQueue);
 					break;
 				case LOCK:
-					TracePrintf(0, "KernelReclaim: Lock %d Reclaimed By Proc %d\n", ipc_id, ((PCB *)curProc)->pid);
+					KTrace(0, "KernelReclaim: Lock %d Reclaimed By Proc %d\n", ipc_id, ((PCB *)curProc)->pid);
 					lock = (Lock *)ipc->content;
 					while((pcb = pop(&lock->lockQueue)) != NULL)
-						push(&readyQueue, pcb);
+						WakePCB(pcb);
 					break;
 				case COND:
 					cond = (Cond *)ipc->content;
 					while((pcb = pop(&cond->waitQueue)) != NULL)
-						push(&readyQueue, pcb);
+						WakePCB(pcb);
+					break;
+				case RWLOCK:
+					rwlock = (RWLock *)ipc->content;
+					while((pcb = pop(&rwlock->readQueue)) != NULL)
+						WakePCB(pcb);
+					while((pcb = pop(&rwlock->writeQueue)) != NULL)
+						WakePCB(pcb);
+					while(pop(&rwlock->readers) != NULL);
 					break;
 				default:
-					TracePrintf(0, "KernelReclaim: Undefined IPC Type %d\n", ipc->type);
+					KTrace(0, "KernelReclaim: Undefined IPC Type %d\n", ipc->type);
 					break;
 			}
 			remove(&ipcQueue, ipc);
@@ -379,3 +741,31 @@ static IPC *createIPC(Type type, void *content)
 	}
 	return ipc;
 }
+
+
+// Take proc off every wait queue of pipes, locks, condition variables and rwlocks
+void KernelIpcCancel(void *proc)
+{
+	foreach(entry, &ipcQueue){
+		IPC *ipc = (IPC *)entry->content;
+		switch(ipc->type){
+			case PIPE:
+				remove(&((Pipe *)ipc->content)->readQueue, proc);
+				remove(&((Pipe *)ipc->content)->writeQueue, proc);
+				remove(&((Pipe *)ipc->content)->pollQueue, proc);
+				break;
+			case LOCK:
+				remove(&((Lock *)ipc->content)->lockQueue, proc);
+				break;
+			case COND:
+				remove(&((Cond *)ipc->content)->waitQueue, proc);
+				break;
+			case RWLOCK:
+				remove(&((RWLock *)ipc->content)->readQueue, proc);
+				remove(&((RWLock *)ipc->content)->writeQueue, proc);
+				break;
+			default:
+				break;
+		}
+	}
+}
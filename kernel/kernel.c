@@ -1,12 +1,19 @@
+#include "../include/bcache.h"
 #include "../include/bitmap.h"
+#include "../include/disk.h"
+#include "../include/filesystem.h"
 #include "../include/hardware.h"
 #include "../include/int_handler.h"
 #include "../include/IPC.h"
 #include "../include/load_info.h"
 #include "../include/mm.h"
+#include "../include/msg.h"
 #include "../include/PCB.h"
 #include "../include/queue.h"
+#include "../include/trace.h"
+#include "../include/tty.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 void *kernelDataStart;
@@ -24,19 +31,24 @@ PCB *curProc;
 PCB *idle;
 Queue readyQueue;
 Queue clockQueue;
-Queue revQueue[NUM_TERMINALS];
 Queue revBlkQueue[NUM_TERMINALS];
 Queue transBlkQueue[NUM_TERMINALS];
-int transReady[NUM_TERMINALS];
+Queue ttyPollQueue[NUM_TERMINALS];
+unsigned int tickCount = 0;
+unsigned int switchCount = 0;
 static char *bitmap;
+// Mappings of Each Physical Frame, a Frame Is Shared When Above 1
+// Every Mapper Owns Frames of Its Own, So the Count Stays Far below the Type's Limit
+static unsigned short *frameRef;
 static int mark = 0;
 static int freeFrameNum;
+static int totalFrameNum;
 static int vm_enable = 0;
 
 
 void KernelStart(char *cmd_args[], unsigned int pmem_size, UserContext *uctxt)
 {
-	TracePrintf(0, "kernel start\n");
+	KTrace(0, "kernel start\n");
 
 	// Trap Handler
 	int i = 0;
@@ -49,14 +61,17 @@ void KernelStart(char *cmd_args[], unsigned int pmem_size, UserContext *uctxt)
 	intvec[TRAP_MATH] = trap_math_handler;
 	intvec[TRAP_TTY_RECEIVE] = trap_tty_rev_handler;
 	intvec[TRAP_TTY_TRANSMIT] = trap_tty_trans_handler;
+	intvec[TRAP_DISK] = trap_disk_handler;
 	WriteRegister(REG_VECTOR_BASE, (signed int)&intvec); 
 	
 	// Bitmap for Physical Memory
-	freeFrameNum = pmem_size / PAGESIZE;
-	TracePrintf(0, "Total 0x%x Pages of Physical Memory\n", freeFrameNum);
+	freeFrameNum = totalFrameNum = pmem_size / PAGESIZE;
+	KTrace(0, "Total 0x%x Pages of Physical Memory\n", freeFrameNum);
 	int sizeOfChar = (freeFrameNum + 7) / 8;
 	bitmap = (char *)malloc(sizeOfChar);
 	bzero(bitmap, sizeOfChar);
+	frameRef = (unsigned short *)malloc(freeFrameNum * sizeof(unsigned short));
+	bzero(frameRef, freeFrameNum * sizeof(unsigned short));
 
 	// Initialize Page Table Entry at Boot Time
 	int startPage = (int)kernelDataStart >> PAGESHIFT;
@@ -70,16 +85,18 @@ void KernelStart(char *cmd_args[], unsigned int pmem_size, UserContext *uctxt)
 		else
 			ptr0[page].prot = PROT_READ | PROT_WRITE;
 		Setbit(bitmap, page);
-		TracePrintf(3, "Kernel Text Page Mapping:%d==>%d\n", page, page);
+		frameRef[page] = 1;
+		KTrace(3, "Kernel Text Page Mapping:%d==>%d\n", page, page);
 	}
 	freeFrameNum -= endPage;
-	TracePrintf(2, "Kernel Stack From 0x%x to 0x%x\n", KERNEL_STACK_BASE, KERNEL_STACK_LIMIT);
+	KTrace(2, "Kernel Stack From 0x%x to 0x%x\n", KERNEL_STACK_BASE, KERNEL_STACK_LIMIT);
 	for(page = KERNEL_STACK_BASEPAGE; page < KERNEL_STACK_LIMITPAGE; page++){
 		ptr0[page].valid = 1;
 		ptr0[page].pfn = page;
 		ptr0[page].prot = PROT_READ | PROT_WRITE;
 		Setbit(bitmap, page);
-		TracePrintf(3, "Kernel Stack Page Mapping:%d==>%d\n", page, page);
+		frameRef[page] = 1;
+		KTrace(3, "Kernel Stack Page Mapping:%d==>%d\n", page, page);
 		freeFrameNum--;
 	}
 
@@ -93,11 +110,25 @@ void KernelStart(char *cmd_args[], unsigned int pmem_size, UserContext *uctxt)
 	clockQueue.head = clockQueue.tail = NULL;
 	readyQueue.head = readyQueue.tail = NULL;
 	InitIPC();
+	InitMsg();
+	InitTty();
+	InitDisk();
+	// Kernel Options Precede the Init Program: bcache=N Cached Sectors, trace to Trace from Boot
+	int bcacheSize = BLOCK_CACHESIZE;
+	while(cmd_args[0] != NULL){
+		if(strncmp(cmd_args[0], "bcache=", 7) == 0)
+			bcacheSize = atoi(cmd_args[0] + 7);
+		else if(strcmp(cmd_args[0], "trace") == 0)
+			TraceControl(1);
+		else
+			break;
+		cmd_args++;
+	}
+	InitBcache(bcacheSize);
 	for(i = 0; i < NUM_TERMINALS; i++){
 		revBlkQueue[i].head = revBlkQueue[i].tail = NULL;
-		revQueue[i].head = revQueue[i].tail = NULL;
 		transBlkQueue[i].head = transBlkQueue[i].tail = NULL;
-		transReady[i] = 1;
+		ttyPollQueue[i].head = ttyPollQueue[i].tail = NULL;
 	}
 	idle = createPCB(uctxt);
 	idle->state = READY;
@@ -109,7 +140,7 @@ void KernelStart(char *cmd_args[], unsigned int pmem_size, UserContext *uctxt)
 	LoadProgram("program/idle", args, idle);
 	KernelContextSwitch(MyKCS, idle, idle);
 	if(mark == 1){
-		TracePrintf(2, "Idle Process Start\n");
+		KTrace(2, "Idle Process Start\n");
 		memcpy(uctxt, &idle->uctxt, sizeof(UserContext));
 		return;
 	}
@@ -138,7 +169,7 @@ void KernelStart(char *cmd_args[], unsigned int pmem_size, UserContext *uctxt)
 //	DATA Start->End PROT_READ | PROT_END
 void SetKernelData(void *_KernelDataStart, void *_KernelDataEnd)
 {
-	TracePrintf(0, "Start=%p, End=%p\n", _KernelDataStart, _KernelDataEnd);
+	KTrace(0, "Start=%p, End=%p\n", _KernelDataStart, _KernelDataEnd);
 	kernelDataStart = _KernelDataStart;
 	kernelDataEnd = _KernelDataEnd;
 }
@@ -156,10 +187,13 @@ int AllocPageFrame(struct pte *pageTable, int startPage, int count, int prot)
 			pageTable[i].valid = 1;
 			pageTable[i].pfn = pos;
 			pageTable[i].prot = prot;
+			frameRef[pos] = 1;
 			Setbit(bitmap, pos++);
-			TracePrintf(3, "Mapping: 0x%x==>0x%x\n", i, pos-1);
+			KTrace(3, "Mapping: 0x%x==>0x%x\n", i, pos-1);
 		}
 		freeFrameNum -= count;
+		if(count > 0)
+			TRACE(TRACE_ALLOC, count, startPage);
 		return 0;
 	}
 }
@@ -169,27 +203,146 @@ void DeallocPageFrame(struct pte *pageTable, int startPage, int count)
 {
 	int page, recycle = 0;
 	for(page = startPage; page < startPage + count; page++){
-		if(pageTable[page].valid != 0){
+		if(pageTable[page].valid != 0 && --frameRef[pageTable[page].pfn] == 0){
 			Clearbit(bitmap, pageTable[page].pfn);
 			recycle++;
-			TracePrintf(3, "UnMapping: 0x%x==>0x%x\n", page, pageTable[page].pfn);
+			KTrace(3, "UnMapping: 0x%x==>0x%x\n", page, pageTable[page].pfn);
 		}
 	}
 	memset(&pageTable[startPage], 0, count * sizeof(struct pte));
 	freeFrameNum += recycle;
+	if(recycle > 0)
+		TRACE(TRACE_FREE, recycle, startPage);
+}
+
+
+// Count the Frames in the Range Mapped Only Here
+int PrivatePageFrames(struct pte *pageTable, int startPage, int count)
+{
+	int page, n = 0;
+	for(page = startPage; page < startPage + count; page++){
+		if(pageTable[page].valid != 0 && frameRef[pageTable[page].pfn] == 1)
+			n++;
+	}
+	return n;
+}
+
+
+// Unmap the range, keeping its private frames in pool and dropping the shared ones
+// Return the number of frames put in pool
+int HarvestPageFrame(struct pte *pageTable, int startPage, int count, int *pool)
+{
+	int page, n = 0;
+	for(page = startPage; page < startPage + count; page++){
+		if(pageTable[page].valid == 0)
+			continue;
+		if(frameRef[pageTable[page].pfn] == 1)
+			pool[n++] = pageTable[page].pfn;
+		else
+			frameRef[pageTable[page].pfn]--;
+	}
+	memset(&pageTable[startPage], 0, count * sizeof(struct pte));
+	return n;
+}
+
+
+// Map the range to frames taken from pool, then to newly allocated ones
+// Return the number of frames allocated, -1 if short of frames
+int ReusePageFrame(struct pte *pageTable, int startPage, int count, int prot, int *pool, int *poolCount)
+{
+	int page;
+	for(page = startPage; page < startPage + count && *poolCount > 0; page++){
+		pageTable[page].valid = 1;
+		pageTable[page].pfn = pool[--*poolCount];
+		pageTable[page].prot = prot;
+	}
+	if(AllocPageFrame(pageTable, page, startPage + count - page, prot) == -1)
+		return -1;
+	return startPage + count - page;
+}
+
+
+// Free the frames left in pool
+void ReleasePageFrame(int *pool, int count)
+{
+	int i;
+	for(i = 0; i < count; i++){
+		frameRef[pool[i]] = 0;
+		Clearbit(bitmap, pool[i]);
+	}
+	freeFrameNum += count;
+	if(count > 0)
+		TRACE(TRACE_FREE, count, 0);
+}
+
+
+// Take One More Reference on the Frames Already Mapped in the Range
+void SharePageFrame(struct pte *pageTable, int startPage, int count)
+{
+	int page;
+	for(page = startPage; page < startPage + count; page++){
+		if(pageTable[page].valid != 0)
+			frameRef[pageTable[page].pfn]++;
+	}
+}
+
+
+int PageFrameShared(struct pte *entry)
+{
+	return entry->valid != 0 && frameRef[entry->pfn] > 1;
+}
+
+
+// Count all physical frames, the free ones, and those referenced more than once
+void FrameCounts(int *total, int *free, int *shared)
+{
+	int i;
+	*total = totalFrameNum;
+	*free = freeFrameNum;
+	*shared = 0;
+	for(i = 0; i < totalFrameNum; i++){
+		if(frameRef[i] > 1)
+			(*shared)++;
+	}
+}
+
+
+// Return 1 If No Page in the Range Is Mapped
+int PageRangeFree(struct pte *pageTable, int startPage, int count)
+{
+	int page;
+	for(page = startPage; page < startPage + count; page++){
+		if(pageTable[page].valid != 0)
+			return 0;
+	}
+	return 1;
+}
+
+
+// Search Downward for count Unmapped Pages in [lowPage, highPage)
+int FindFreePages(struct pte *pageTable, int lowPage, int highPage, int count)
+{
+	int page, run = 0;
+	for(page = highPage - 1; page >= lowPage; page--){
+		if(pageTable[page].valid != 0)
+			run = 0;
+		else if(++run == count)
+			return page;
+	}
+	return -1;
 }
 
 
 int CheckPageFrame(count)
 {
 	/*
-	TracePrintf(2, "Current Free Frame = %d\n", freeFrameNum);
+	KTrace(2, "Current Free Frame = %d\n", freeFrameNum);
 	int i=0, c=0;
 	for(;i<512;i++){
 		if(Getbit(bitmap, i) == 0)
 			c++;
 	}
-	TracePrintf(2, "Current Free Frame = %d\n", c);*/
+	KTrace(2, "Current Free Frame = %d\n", c);*/
 	if(count <= freeFrameNum)
 		return 0;
 	else
@@ -209,9 +362,29 @@ void DuplicateUserAll(struct pte *target)
 }
 
 
+void ZeroPageFrame(struct pte *pageTable, int startPage, int count)
+{
+	int s_page = KERNEL_STACK_BASEPAGE - 1;
+	void *s_addr = (void *)(s_page << PAGESHIFT);
+	struct pte s_pte = ptr0[s_page];
+	ptr0[s_page].valid = 1;
+	ptr0[s_page].prot = PROT_READ | PROT_WRITE;
+	int page = startPage;
+	for(; page < startPage + count; page++){
+		if(pageTable[page].valid == 1){
+			ptr0[s_page].pfn = pageTable[page].pfn;
+			WriteRegister(REG_TLB_FLUSH, (unsigned int)s_addr);
+			memset(s_addr, 0, PAGESIZE);
+		}
+	}
+	ptr0[s_page] = s_pte;
+	WriteRegister(REG_TLB_FLUSH, (unsigned int)s_addr);
+}
+
+
 static void DuplicatePageFrame(struct pte *target, void *srcAddr, int count)
 {
-	TracePrintf(2, "Duplicate from Src = %p, Count = %d\n", srcAddr, count);
+	KTrace(2, "Duplicate from Src = %p, Count = %d\n", srcAddr, count);
 	int s_page = KERNEL_STACK_BASEPAGE - 1;
 	void *s_addr = (void *)(s_page << PAGESHIFT);
 	struct pte s_pte = ptr0[s_page];
@@ -219,7 +392,8 @@ static void DuplicatePageFrame(struct pte *target, void *srcAddr, int count)
 	ptr0[s_page].prot = PROT_READ | PROT_WRITE;
 	int page = 0;
 	for(; page < count; srcAddr += PAGESIZE, page++){
-		if(target[page].valid == 1){
+		// Shared Frames Are Mapped, Not Copied, and Unloaded File Pages Are Unreadable
+		if(target[page].valid == 1 && frameRef[target[page].pfn] == 1 && target[page].prot != PROT_NONE){
 			ptr0[s_page].pfn = target[page].pfn;
 			WriteRegister(REG_TLB_FLUSH, (unsigned int)s_addr);
 			memcpy(s_addr, srcAddr, PAGESIZE);
@@ -230,15 +404,82 @@ static void DuplicatePageFrame(struct pte *target, void *srcAddr, int count)
 }
 
 
+// Copy len bytes from kernel memory to dst in the region 1 of another page table
+void CopyToPageTable(struct pte *pageTable, void *dst, void *src, int len)
+{
+	int s_page = KERNEL_STACK_BASEPAGE - 1;
+	void *s_addr = (void *)(s_page << PAGESHIFT);
+	struct pte s_pte = ptr0[s_page];
+	ptr0[s_page].valid = 1;
+	ptr0[s_page].prot = PROT_READ | PROT_WRITE;
+	while(len > 0){
+		int offset = (int)dst & PAGEOFFSET;
+		int count = PAGESIZE - offset;
+		if(count > len)
+			count = len;
+		ptr0[s_page].pfn = pageTable[(int)(dst - VMEM_1_BASE) >> PAGESHIFT].pfn;
+		WriteRegister(REG_TLB_FLUSH, (unsigned int)s_addr);
+		memcpy(s_addr + offset, src, count);
+		dst += count;
+		src += count;
+		len -= count;
+	}
+	ptr0[s_page] = s_pte;
+	WriteRegister(REG_TLB_FLUSH, (unsigned int)s_addr);
+}
+
+
+// Copy len bytes at src of another region 1 to dst through the scratch page
+void CopyFromPageTable(struct pte *pageTable, void *dst, void *src, int len)
+{
+	int s_page = KERNEL_STACK_BASEPAGE - 1;
+	void *s_addr = (void *)(s_page << PAGESHIFT);
+	struct pte s_pte = ptr0[s_page];
+	ptr0[s_page].valid = 1;
+	ptr0[s_page].prot = PROT_READ | PROT_WRITE;
+	while(len > 0){
+		int offset = (int)src & PAGEOFFSET;
+		int count = PAGESIZE - offset;
+		if(count > len)
+			count = len;
+		ptr0[s_page].pfn = pageTable[(int)(src - VMEM_1_BASE) >> PAGESHIFT].pfn;
+		WriteRegister(REG_TLB_FLUSH, (unsigned int)s_addr);
+		memcpy(dst, s_addr + offset, count);
+		dst += count;
+		src += count;
+		len -= count;
+	}
+	ptr0[s_page] = s_pte;
+	WriteRegister(REG_TLB_FLUSH, (unsigned int)s_addr);
+}
+
+
+// Whether [addr, addr + len) of region 1 is mapped with prot in pageTable
+int PageRangeValid(struct pte *pageTable, void *addr, int len, int prot)
+{
+	if(len < 0 || (int)addr < VMEM_1_BASE || (int)addr + len > VMEM_1_LIMIT)
+		return 0;
+	if(len == 0)
+		return 1;
+	int page = (int)(addr - VMEM_1_BASE) >> PAGESHIFT;
+	int endPage = (int)(addr - VMEM_1_BASE + len - 1) >> PAGESHIFT;
+	for(; page <= endPage; page++){
+		if(pageTable[page].valid == 0 || (pageTable[page].prot & prot) != prot)
+			return 0;
+	}
+	return 1;
+}
+
+
 // The addr is automatically round to the boundary.
 int SetKernelBrk(void *addr)
 {
-	TracePrintf(0, "SetKernelBrk: Current Addr = %p\n", addr);
+	KTrace(3, "SetKernelBrk: Current Addr = %p\n", addr);
 	if((int)addr > KERNEL_STACK_BASE){
-		TracePrintf(0, "SetKernelBrk: Trying to Access Stack Addr = %p\n", addr);
+		KTrace(0, "SetKernelBrk: Trying to Access Stack Addr = %p\n", addr);
 		return -1;
 	}else if(addr <= kernelDataStart){
-		TracePrintf(0, "SetKernelBrk: Trying to Access Text Addr = %p\n", addr);
+		KTrace(0, "SetKernelBrk: Trying to Access Text Addr = %p\n", addr);
 		return -1;
 	}else{
 		if(!vm_enable)
@@ -251,7 +492,7 @@ int SetKernelBrk(void *addr)
 				count = ((int)addr >> PAGESHIFT) - startPage;
 				int result = AllocPageFrame(ptr0, startPage, count, PROT_READ | PROT_WRITE);
 				if(result == -1){
-					TracePrintf(0, "SetKernelBrk: No Enough Memory\n");
+					KTrace(0, "SetKernelBrk: No Enough Memory\n");
 					return -1;
 				}
 			}else{
@@ -273,8 +514,12 @@ KernelContext *MyKCS(KernelContext *kctxt, void *oldPCB, void *newPCB)
 		memcpy(&new_PCB->kctxt, kctxt, sizeof(new_PCB->kctxt));
 		DuplicateKernelStack(new_PCB->pageTableStackR0);
 	}else{
-		if(oldPCB != NULL)
+		switchCount++;
+		if(oldPCB != NULL){
+			TRACE(TRACE_SWITCH, ((PCB *)oldPCB)->pid, new_PCB->pid);
 			memcpy(&((PCB *)oldPCB)->kctxt, kctxt, sizeof(KernelContext));
+		}else
+			TRACE(TRACE_SWITCH, 0, new_PCB->pid);
 		memcpy(&ptr0[KERNEL_STACK_BASEPAGE], new_PCB->pageTableStackR0, sizeof(new_PCB->pageTableStackR0));
 		WriteRegister(REG_PTBR1, (unsigned int)new_PCB->pageTableR1);
 		WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
@@ -0,0 +1,170 @@
+#include <string.h>
+
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/IPC.h"
+#include "../include/kstat.h"
+#include "../include/mm.h"
+#include "../include/PCB.h"
+#include "../include/queue.h"
+#include "../include/tty.h"
+
+extern PCB *curProc;
+extern PCB *idle;
+extern Queue procQueue;
+extern Queue readyQueue;
+extern Queue clockQueue;
+extern Queue revBlkQueue[NUM_TERMINALS];
+extern Queue transBlkQueue[NUM_TERMINALS];
+extern Queue ipcQueue;
+extern TxRing txRing[NUM_TERMINALS];
+extern RxRing rxRing[NUM_TERMINALS];
+extern unsigned int tickCount;
+extern unsigned int switchCount;
+
+static int QueueLength(Queue *queue);
+static int InQueue(Queue *queue, void *content);
+static int ProcState(PCB *pcb);
+static void KStatIpc(KStatSnap *snap);
+static void KStatProcs(KStatSnap *snap);
+
+
+static int QueueLength(Queue *queue)
+{
+	int len = 0;
+	foreach(entry, queue)
+		len++;
+	return len;
+}
+
+
+static int InQueue(Queue *queue, void *content)
+{
+	foreach(entry, queue){
+		if(entry->content == content)
+			return 1;
+	}
+	return 0;
+}
+
+
+static int ProcState(PCB *pcb)
+{
+	int i;
+	if(pcb == curProc)
+		return KSTAT_RUNNING;
+	if(InQueue(&readyQueue, pcb))
+		return KSTAT_READY;
+	if(InQueue(&clockQueue, pcb))
+		return KSTAT_DELAY;
+	for(i = 0; i < NUM_TERMINALS; i++){
+		if(InQueue(&revBlkQueue[i], pcb) || InQueue(&transBlkQueue[i], pcb))
+			return KSTAT_TTY;
+	}
+	if(pcb->state == WAIT)
+		return KSTAT_WAIT;
+	return KSTAT_BLOCKED;
+}
+
+
+static void KStatIpc(KStatSnap *snap)
+{
+	IPC *ipc;
+	Pipe *pipe;
+	Lock *lock;
+	RWLock *rwlock;
+	foreach(entry, &ipcQueue){
+		ipc = (IPC *)entry->content;
+		switch(ipc->type){
+			case PIPE:
+				pipe = (Pipe *)ipc->content;
+				snap->pipes++;
+				snap->pipeBytes += (pipe->write_ptr - pipe->read_ptr + PIPE_LEN) % PIPE_LEN;
+				snap->ipcWaiters += QueueLength(&pipe->readQueue) + QueueLength(&pipe->writeQueue);
+				break;
+			case LOCK:
+				lock = (Lock *)ipc->content;
+				snap->locks++;
+				snap->ipcWaiters += QueueLength(&lock->lockQueue);
+				break;
+			case COND:
+				snap->cvars++;
+				snap->ipcWaiters += QueueLength(&((Cond *)ipc->content)->waitQueue);
+				break;
+			case RWLOCK:
+				rwlock = (RWLock *)ipc->content;
+				snap->rwlocks++;
+				snap->ipcWaiters += QueueLength(&rwlock->readQueue) + QueueLength(&rwlock->writeQueue);
+				break;
+			case SHM:
+				snap->shms++;
+				break;
+		}
+	}
+}
+
+
+static void KStatProcs(KStatSnap *snap)
+{
+	KStatProc *proc;
+	PCB *pcb;
+	int page;
+	foreach(entry, &procQueue){
+		pcb = (PCB *)entry->content;
+		if(pcb == idle)
+			continue;
+		if(snap->procs++ >= KSTAT_PROCS)
+			continue;
+		proc = &snap->proc[snap->procs - 1];
+		proc->pid = pcb->pid;
+		proc->ppid = 0;
+		if(pcb->parent != NULL)
+			proc->ppid = pcb->parent->pid;
+		proc->group = 0;
+		if(pcb->group != NULL)
+			proc->group = pcb->group->pid;
+		proc->state = ProcState(pcb);
+		if(proc->state != KSTAT_RUNNING && proc->state != KSTAT_READY)
+			snap->blocked++;
+		// A VFork Child Borrows Its Parent's Pages
+		if(pcb->pageTableR1 == pcb->ownPageTableR1){
+			for(page = 0; page < VMEM_1_PNUM; page++){
+				if(pcb->pageTableR1[page].valid == 0)
+					continue;
+				proc->residentPages++;
+				if(PageFrameShared(&pcb->pageTableR1[page]))
+					proc->sharedPages++;
+			}
+		}
+		proc->brkPages = ((int)pcb->brkR1 - VMEM_1_BASE) >> PAGESHIFT;
+		proc->stackPages = (VMEM_1_LIMIT - (int)pcb->stackR1) >> PAGESHIFT;
+		strncpy(proc->name, pcb->name, KSTAT_NAME_LEN - 1);
+	}
+}
+
+
+// Fill snap with the current kernel state, the idle process is left out
+void KernelKStat(KStatSnap *snap)
+{
+	int total, free, shared, i;
+	memset(snap, 0, sizeof(KStatSnap));
+	snap->version = KSTAT_VERSION;
+	snap->size = sizeof(KStatSnap);
+	snap->ticks = tickCount;
+	snap->switches = switchCount;
+	FrameCounts(&total, &free, &shared);
+	snap->totalFrames = total;
+	snap->freeFrames = free;
+	snap->usedFrames = total - free;
+	snap->sharedFrames = shared;
+	snap->ready = QueueLength(&readyQueue);
+	snap->delayed = QueueLength(&clockQueue);
+	KStatIpc(snap);
+	for(i = 0; i < NUM_TERMINALS; i++){
+		snap->tty[i].txQueued = txRing[i].count;
+		snap->tty[i].rxLines = rxRing[i].lines;
+		snap->tty[i].readers = QueueLength(&revBlkQueue[i]);
+		snap->tty[i].writers = QueueLength(&transBlkQueue[i]);
+	}
+	KStatProcs(snap);
+}
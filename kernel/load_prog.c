@@ -2,12 +2,19 @@
 #include <unistd.h>
 #include <sys/types.h>
 
+#include "../include/custom.h"
+#include "../include/exec_cache.h"
 #include "../include/load_info.h"
 #include "../include/hardware.h"
+#include "../include/IPC.h"
 #include "../include/mm.h"
+#include "../include/mmap.h"
 #include "../include/PCB.h"
+#include "../include/trace.h"
 #include "../include/yalnix.h"
 
+extern ExecStats execStats;
+
 
 /*
  *  Load a program into an existing address space.  The program comes from
@@ -41,26 +48,45 @@ LoadProgram(char *name, char *args[], PCB *proc)
 	int stack_npg;
 	long segment_size;
 	char *argbuf;
+	char *path;
+	ExecImage *image;
+	time_t mtime;
+	off_t fsize;
+	int need;
+	int pool[VMEM_1_PNUM];
+	int poolCount;
+	int allocated;
   
+  /*
+   * A cached image of an unchanged file needs no file access at all,
+   * fd stays -1 for it.
+   */
+	fd = -1;
+	image = ExecCacheFind(name, &mtime, &fsize);
+	if (image != NULL) {
+		li = image->li;
+		KTrace(2, "LoadProgram: '%s' from the exec cache\n", name);
+	} else {
   /*
    * Open the executable file 
    */
 	if ((fd = open(name, O_RDONLY)) < 0) {
-		TracePrintf(0, "LoadProgram: can't open file '%s'\n", name);
+		KTrace(0, "LoadProgram: can't open file '%s'\n", name);
 		return ERROR;
 	}
 
 	if (LoadInfo(fd, &li) != LI_NO_ERROR) {
-		TracePrintf(0, "LoadProgram: '%s' not in Yalnix format\n", name);
+		KTrace(0, "LoadProgram: '%s' not in Yalnix format\n", name);
 		close(fd);
 		return (-1);
 	}
 
 	if (li.entry < VMEM_1_BASE) {
-		TracePrintf(0, "LoadProgram: '%s' not linked for Yalnix\n", name);
+		KTrace(0, "LoadProgram: '%s' not linked for Yalnix\n", name);
 		close(fd);
 		return ERROR;
 	}
+	}
 
   /*
    * Figure out in what region 1 page the different program sections
@@ -76,11 +102,11 @@ LoadProgram(char *name, char *args[], PCB *proc)
    */
 	size = 0;
 	for (i = 0; args[i] != NULL; i++) {
-		TracePrintf(3, "counting arg %d = '%s'\n", i, args[i]);
+		KTrace(3, "counting arg %d = '%s'\n", i, args[i]);
 		size += strlen(args[i]) + 1;
 	}
 	argcount = i;
-	TracePrintf(2, "LoadProgram: argsize %d, argcount %d\n", size, argcount);
+	KTrace(2, "LoadProgram: argsize %d, argcount %d\n", size, argcount);
   
   /*
    *  The arguments will get copied starting at "cp", and the argv
@@ -100,7 +126,7 @@ LoadProgram(char *name, char *args[], PCB *proc)
    * reserved above the stack pointer, before the arguments.
    */
 	cp2 = (caddr_t)cpp - INITIAL_STACK_FRAME_SIZE;
-	TracePrintf(1, "prog_size %d, text %d data %d bss %d pages\n",
+	KTrace(1, "prog_size %d, text %d data %d bss %d pages\n",
 	      li.t_npg + data_npg, li.t_npg, li.id_npg, li.ud_npg);
 
 
@@ -108,12 +134,13 @@ LoadProgram(char *name, char *args[], PCB *proc)
    * Compute how many pages we need for the stack */
 	stack_npg = (VMEM_1_LIMIT - DOWN_TO_PAGE(cp2)) >> PAGESHIFT;
 	stack_pg1 = (USER_STACK_LIMIT - VMEM_1_BASE - stack_npg * PAGESIZE) >> PAGESHIFT;
-	TracePrintf(1, "LoadProgram: heap_size %d, stack_size %d\n", li.t_npg + data_npg, stack_npg);
+	KTrace(1, "LoadProgram: heap_size %d, stack_size %d\n", li.t_npg + data_npg, stack_npg);
 
 
   /* leave at least one page between heap and stack */
 	if (stack_npg + data_pg1 + data_npg >= MAX_PT_LEN) {
-		close(fd);
+		if (fd >= 0)
+			close(fd);
 		return ERROR;
 	}
 
@@ -133,25 +160,38 @@ LoadProgram(char *name, char *args[], PCB *proc)
 
   /*
    * Now save the arguments in a separate buffer in region 0, since
-   * we are about to blow away all of region 1.
+   * we are about to blow away all of region 1.  The path follows them,
+   * as name may point into region 1 as well.
    */
-	cp2 = argbuf = (char *)malloc(size);
+	cp2 = argbuf = (char *)malloc(size + strlen(name) + 1);
 //==>> You should perhaps check that malloc returned valid space
 	if(cp2 == NULL){
-		close(fd);
+		if(fd >= 0)
+			close(fd);
 		return ERROR;
 	}
 	for (i = 0; args[i] != NULL; i++) {
-		TracePrintf(3, "saving arg %d = '%s'\n", i, args[i]);
+		KTrace(3, "saving arg %d = '%s'\n", i, args[i]);
 		strcpy(cp2, args[i]);
 		cp2 += strlen(cp2) + 1;
 	}
+	path = cp2;
+	strcpy(path, name);
 
 	// Make Sure to Check Free Page Frame Before Blow Away Region 1 
-	if(CheckPageFrame(li.t_npg + data_npg + stack_npg) == -1){
+	// Cached Text Is Shared, and Cached Images Give Their Frames back If Short
+	// Frames Only proc Maps Are Reused, So Only the Difference Is Needed
+	need = data_npg + stack_npg;
+	if(image == NULL){
+		need += li.t_npg;
+		if(CheckPageFrame(need - PrivatePageFrames(proc->pageTableR1, 0, VMEM_1_PNUM)) == -1)
+			ExecCacheFlush();
+	}
+	if(CheckPageFrame(need - PrivatePageFrames(proc->pageTableR1, 0, VMEM_1_PNUM)) == -1){
 		free(argbuf);
-		close(fd);
-		TracePrintf(0, "Load: No Enough Physical Memory\n");
+		if(fd >= 0)
+			close(fd);
+		KTrace(0, "Load: No Enough Physical Memory\n");
 		return ERROR;
 	}
 
@@ -174,7 +214,13 @@ LoadProgram(char *name, char *args[], PCB *proc)
 ==>> deallocate a few pages to fit the size of memory to the requirements
 ==>> of the new process.
 */
-	DeallocPageFrame(proc->pageTableR1, 0, VMEM_1_PNUM);
+	KernelShmDetachAll(proc);
+	// SysExec Already Wrote the Mapped Pages back
+	while(proc->mappings.head != NULL)
+		FreeMapping(proc, proc->mappings.head->content);
+	// Keep the Private Frames for the New Image Instead of Freeing Them
+	poolCount = HarvestPageFrame(proc->pageTableR1, 0, VMEM_1_PNUM, pool);
+	execStats.framesReused += poolCount;
 
 /*
 ==>> Allocate "li.t_npg" physical pages and map them starting at
@@ -188,8 +234,13 @@ LoadProgram(char *name, char *args[], PCB *proc)
 ==>> (PROT_READ | PROT_WRITE).
 */
 
-	AllocPageFrame(proc->pageTableR1, text_pg1, li.t_npg, PROT_READ | PROT_WRITE);
-	AllocPageFrame(proc->pageTableR1, data_pg1, data_npg, PROT_READ | PROT_WRITE);
+	if(image != NULL){
+		memcpy(&proc->pageTableR1[text_pg1], image->text, li.t_npg * sizeof(struct pte));
+		SharePageFrame(proc->pageTableR1, text_pg1, li.t_npg);
+		allocated = 0;
+	}else
+		allocated = ReusePageFrame(proc->pageTableR1, text_pg1, li.t_npg, PROT_READ | PROT_WRITE, pool, &poolCount);
+	allocated += ReusePageFrame(proc->pageTableR1, data_pg1, data_npg, PROT_READ | PROT_WRITE, pool, &poolCount);
 	proc->dataR1 = (void *)li.id_vaddr;
 	proc->brkR1 = (void *)(((data_pg1 + data_npg) << PAGESHIFT) + VMEM_1_BASE);
 		
@@ -200,15 +251,23 @@ LoadProgram(char *name, char *args[], PCB *proc)
 ==>> These pages should be marked valid, with a
 ==>> protection of (PROT_READ | PROT_WRITE).
    */
-	AllocPageFrame(proc->pageTableR1, stack_pg1, stack_npg, PROT_READ | PROT_WRITE);
+	allocated += ReusePageFrame(proc->pageTableR1, stack_pg1, stack_npg, PROT_READ | PROT_WRITE, pool, &poolCount);
+	// Frames the New Image Does Not Need
+	ReleasePageFrame(pool, poolCount);
+	execStats.framesReused -= poolCount;
+	execStats.framesAllocated += allocated;
+	execStats.framesFreed += poolCount;
 	proc->stackR1 = (void *)((stack_pg1 << PAGESHIFT) + VMEM_1_BASE);
-	TracePrintf(2, "Cur Brk = %p, Cur Stack Limmit = %p\n", proc->brkR1, proc->stackR1);
+	KTrace(2, "Cur Brk = %p, Cur Stack Limmit = %p\n", proc->brkR1, proc->stackR1);
 	// Flush TLB_1 to Make Sure Right Relevance and Right Prot
 	WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
   /*
    * All pages for the new address space are now in the page table.  
    * But they are not yet in the TLB, remember!
    */
+	if(image != NULL){
+		memcpy((void *)li.id_vaddr, image->data, li.id_npg << PAGESHIFT);
+	}else{
   /*
    * Read the text from the file into memory.
    */
@@ -255,6 +314,9 @@ LoadProgram(char *name, char *args[], PCB *proc)
 	// Flush TLB_1 Again For PROT
 	WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
 	close(fd);			/* we've read it all now */
+	// Data Is Still Pristine before bss Is Zeroed
+	ExecCacheInsert(path, mtime, fsize, &li, &proc->pageTableR1[text_pg1]);
+	}
 
   /*
    * Zero out the uninitialized data area
@@ -266,6 +328,8 @@ LoadProgram(char *name, char *args[], PCB *proc)
    */
 //==>> Here you should put your data structure (PCB or process)
 	proc->uctxt.pc = (caddr_t) li.entry;
+	strncpy(proc->name, path, PCB_NAME_LEN - 1);
+	proc->name[PCB_NAME_LEN - 1] = '\0';
   /*
    * Now, finally, build the argument list on the new stack.
    */
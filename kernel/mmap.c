@@ -0,0 +1,101 @@
+#include "../include/hardware.h"
+#include "../include/IPC.h"
+#include "../include/mm.h"
+#include "../include/mmap.h"
+#include "../include/PCB.h"
+#include "../include/queue.h"
+#include "../include/trace.h"
+
+extern PCB *curProc;
+
+// Map n sectors into the highest free pages between brk and stack of curProc's process
+// Frames are reserved now and filled on the first fault, return the start page
+int KernelMmap(int *sectors, int n)
+{
+	PCB *proc = GroupOf(curProc);
+	int npg = (n + SECTORS_PER_PAGE - 1) / SECTORS_PER_PAGE;
+	Mapping *map = (Mapping *)malloc(sizeof(Mapping));
+	if(map == NULL)
+		return IPC_ERROR;
+	map->sectors = (int *)calloc(npg * SECTORS_PER_PAGE, sizeof(int));
+	map->state = (char *)calloc(npg, 1);
+	int lowPage = ((int)(proc->brkR1 - VMEM_1_BASE) >> PAGESHIFT) + 1;
+	int highPage = ((int)(proc->stackR1 - VMEM_1_BASE) >> PAGESHIFT) - SHM_STACK_GAP;
+	map->startPage = FindFreePages(proc->pageTableR1, lowPage, highPage, npg);
+	if(map->sectors == NULL || map->state == NULL || map->startPage == -1
+		|| AllocPageFrame(proc->pageTableR1, map->startPage, npg, PROT_NONE) == -1
+		|| push(&proc->mappings, map) == -1){
+		KTrace(0, "KernelMmap: No Room for %d Pages in Proc %d\n", npg, proc->pid);
+		if(map->startPage != -1)
+			DeallocPageFrame(proc->pageTableR1, map->startPage, npg);
+		free(map->sectors);
+		free(map->state);
+		free(map);
+		return IPC_ERROR;
+	}
+	map->npg = npg;
+	map->busy = 0;
+	map->waitQueue.head = map->waitQueue.tail = NULL;
+	memcpy(map->sectors, sectors, n * sizeof(int));
+	WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+	return map->startPage;
+}
+
+
+Mapping *FindMapping(void *proc, int page)
+{
+	foreach(entry, &((PCB *)proc)->mappings){
+		Mapping *map = entry->content;
+		if(map->startPage <= page && page < map->startPage + map->npg)
+			return map;
+	}
+	return NULL;
+}
+
+
+// The forked child maps the same sectors over its copies of the frames, all of them clean
+void KernelMmapFork(void *parent, void *child)
+{
+	foreach(entry, &((PCB *)parent)->mappings){
+		Mapping *map = entry->content;
+		Mapping *copy = (Mapping *)malloc(sizeof(Mapping));
+		if(copy == NULL)
+			continue;
+		*copy = *map;
+		copy->sectors = (int *)malloc(map->npg * SECTORS_PER_PAGE * sizeof(int));
+		copy->state = (char *)malloc(map->npg);
+		if(copy->sectors == NULL || copy->state == NULL || push(&((PCB *)child)->mappings, copy) == -1){
+			free(copy->sectors);
+			free(copy->state);
+			free(copy);
+			continue;
+		}
+		memcpy(copy->sectors, map->sectors, map->npg * SECTORS_PER_PAGE * sizeof(int));
+		memcpy(copy->state, map->state, map->npg);
+		copy->busy = 0;
+		copy->waitQueue.head = copy->waitQueue.tail = NULL;
+		// A Page Another Thread Is Loading Is Loaded Afresh in the Child
+		// Dirty Pages Are the Parent's to Write back, the Child Writes Only What It Dirties Itself
+		int p;
+		for(p = 0; p < copy->npg; p++){
+			if(copy->state[p] == MAP_LOADING)
+				copy->state[p] = MAP_ABSENT;
+			else if(copy->state[p] == MAP_DIRTY){
+				copy->state[p] = MAP_CLEAN;
+				((PCB *)child)->pageTableR1[copy->startPage + p].prot = PROT_READ;
+			}
+		}
+	}
+}
+
+
+// Drop the mapping and its frames, dirty pages must be written back first
+void FreeMapping(void *proc, Mapping *map)
+{
+	remove(&((PCB *)proc)->mappings, map);
+	DeallocPageFrame(((PCB *)proc)->pageTableR1, map->startPage, map->npg);
+	free(map->sectors);
+	free(map->state);
+	free(map);
+	WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+}
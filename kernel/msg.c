@@ -0,0 +1,179 @@
+#include "../include/hardware.h"
+#include "../include/IPC.h"
+#include "../include/mm.h"
+#include "../include/msg.h"
+#include "../include/PCB.h"
+#include "../include/queue.h"
+#include "../include/trace.h"
+
+extern Queue readyQueue;
+extern PCB *curProc;
+extern Queue procQueue;
+
+// Registered Servers, Indexed by Service Id
+static PCB *services[MAX_SERVICES];
+static PCB *FindReceiver(int);
+static PCB *FindPending(int);
+
+void InitMsg(void)
+{
+	int i;
+	for(i = 0; i < MAX_SERVICES; i++)
+		services[i] = NULL;
+}
+
+
+int KernelRegister(unsigned int service)
+{
+	if(service >= MAX_SERVICES || services[service] != NULL){
+		KTrace(0, "KernelRegister: Service %u Invalid or Taken\n", service);
+		return IPC_ERROR;
+	}
+	services[service] = curProc;
+	return 0;
+}
+
+
+// Queue curProc's message for pid, or for service -pid if pid is negative
+// The caller blocks until msgState leaves MSG_SENT and MSG_RECEIVED
+int KernelSend(void *msg, int pid)
+{
+	PCB *receiver = FindReceiver(pid);
+	if(receiver == NULL || receiver == curProc){
+		KTrace(0, "KernelSend: No Receiver %d\n", pid);
+		return IPC_ERROR;
+	}
+	if(push(&receiver->msgQueue, curProc) == -1)
+		return IPC_ERROR;
+	memcpy(curProc->msg, msg, MSG_LEN);
+	curProc->msgState = MSG_SENT;
+	if(receiver->receiving){
+		receiver->receiving = 0;
+		WakePCB(receiver);
+	}
+	return IPC_BLOCK;
+}
+
+
+// Take the oldest message into msg and return its sender's pid
+int KernelReceive(void *msg)
+{
+	PCB *sender = pop(&curProc->msgQueue);
+	if(sender == NULL){
+		curProc->receiving = 1;
+		return IPC_BLOCK;
+	}
+	if(push(&curProc->msgPending, sender) == -1){
+		sender->msgState = MSG_FAILED;
+		WakePCB(sender);
+		return IPC_ERROR;
+	}
+	memcpy(msg, sender->msg, MSG_LEN);
+	sender->msgState = MSG_RECEIVED;
+	return sender->pid;
+}
+
+
+int KernelReply(void *msg, int pid)
+{
+	PCB *sender = FindPending(pid);
+	if(sender == NULL){
+		KTrace(0, "KernelReply: Proc %d Is Not Waiting for a Reply\n", pid);
+		return IPC_ERROR;
+	}
+	remove(&curProc->msgPending, sender);
+	memcpy(sender->msg, msg, MSG_LEN);
+	sender->msgState = MSG_REPLIED;
+	WakePCB(sender);
+	return 0;
+}
+
+
+// The sender pid waiting for our reply, NULL if there is none
+void *KernelMsgSender(int pid)
+{
+	return FindPending(pid);
+}
+
+
+// Copy len bytes at src of a sender waiting for our reply to dest
+int KernelCopyFrom(int pid, void *dest, void *src, int len)
+{
+	PCB *sender = FindPending(pid);
+	if(sender == NULL || !PageRangeValid(sender->pageTableR1, src, len, PROT_READ)){
+		KTrace(0, "KernelCopyFrom: Invalid Proc %d or Range %p\n", pid, src);
+		return IPC_ERROR;
+	}
+	CopyFromPageTable(sender->pageTableR1, dest, src, len);
+	return 0;
+}
+
+
+int KernelCopyTo(int pid, void *dest, void *src, int len)
+{
+	PCB *sender = FindPending(pid);
+	if(sender == NULL || !PageRangeValid(sender->pageTableR1, dest, len, PROT_READ | PROT_WRITE)){
+		KTrace(0, "KernelCopyTo: Invalid Proc %d or Range %p\n", pid, dest);
+		return IPC_ERROR;
+	}
+	CopyToPageTable(sender->pageTableR1, dest, src, len);
+	return 0;
+}
+
+
+// Drop the exiting process's services and fail everyone sending to it
+void KernelMsgExit(void *proc)
+{
+	PCB *pcb = proc, *sender;
+	int i;
+	for(i = 0; i < MAX_SERVICES; i++)
+		if(services[i] == pcb)
+			services[i] = NULL;
+	while((sender = pop(&pcb->msgQueue)) != NULL){
+		sender->msgState = MSG_FAILED;
+		WakePCB(sender);
+	}
+	while((sender = pop(&pcb->msgPending)) != NULL){
+		sender->msgState = MSG_FAILED;
+		WakePCB(sender);
+	}
+}
+
+
+// Withdraw the messages proc sent, so no server replies to it
+void KernelMsgCancel(void *proc)
+{
+	foreach(entry, &procQueue){
+		remove(&((PCB *)entry->content)->msgQueue, proc);
+		remove(&((PCB *)entry->content)->msgPending, proc);
+	}
+	((PCB *)proc)->msgState = MSG_NONE;
+	((PCB *)proc)->receiving = 0;
+}
+
+
+// Servers are addressed by -service, or by pid
+static PCB *FindReceiver(int pid)
+{
+	int i;
+	if(pid < 0){
+		if(pid <= -MAX_SERVICES)
+			return NULL;
+		return services[-pid];
+	}
+	for(i = 0; i < MAX_SERVICES; i++)
+		if(services[i] != NULL && services[i]->pid == pid)
+			return services[i];
+	return NULL;
+}
+
+
+static PCB *FindPending(int pid)
+{
+	foreach(entry, &curProc->msgPending){
+		PCB *sender = entry->content;
+		if(sender->pid == pid)
+			return sender;
+	}
+	return NULL;
+}
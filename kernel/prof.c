@@ -0,0 +1,174 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/hardware.h"
+#include "../include/PCB.h"
+#include "../include/prof.h"
+#include "../include/trace.h"
+
+extern PCB *curProc;
+
+int profMode = PROF_OFF;
+static Profile *profiles;
+static unsigned int profLost = 0;
+// Mode the Profiles Were Taken in
+static int profilesMode = PROF_OFF;
+
+static Profile *ProfFind(PCB *pcb);
+static int ProfReadable(unsigned int addr);
+
+
+// The Profile of pcb and Its Program, Started on the First Sample
+static Profile *ProfFind(PCB *pcb)
+{
+	int i;
+	for(i = 0; i < PROF_PROCS; i++){
+		if(profiles[i].pid == pcb->pid && strcmp(profiles[i].name, pcb->name) == 0)
+			return &profiles[i];
+	}
+	for(i = 0; i < PROF_PROCS; i++){
+		if(profiles[i].pid == 0){
+			profiles[i].pid = pcb->pid;
+			strcpy(profiles[i].name, pcb->name);
+			return &profiles[i];
+		}
+	}
+	return NULL;
+}
+
+
+// Whether the two words of a frame at addr of region 1 can be read, without ValidatePtr's traces
+static int ProfReadable(unsigned int addr)
+{
+	int page;
+	if(addr < VMEM_1_BASE || addr > VMEM_1_LIMIT - 2 * sizeof(unsigned int) || (addr & 3) != 0)
+		return 0;
+	// Both Words on One Page, so Checking Its Page Covers fp[1]
+	if((addr & PAGEOFFSET) > PAGESIZE - 2 * sizeof(unsigned int))
+		return 0;
+	page = (addr - VMEM_1_BASE) >> PAGESHIFT;
+	return curProc->pageTableR1[page].valid != 0 && (curProc->pageTableR1[page].prot & PROT_READ) != 0;
+}
+
+
+// Count the pc interrupted by the clock, and in PROF_PC mode its callers
+void ProfSample(UserContext *uctxt)
+{
+	Profile *prof;
+	ProfBucket *bucket;
+	unsigned int pc[PROF_DEPTH];
+	unsigned int *fp;
+	unsigned int hash = 0;
+	int i;
+	if(curProc == NULL)
+		return;
+	if((prof = ProfFind(curProc)) == NULL){
+		profLost++;
+		return;
+	}
+	prof->samples++;
+	memset(pc, 0, sizeof(pc));
+	pc[0] = (unsigned int)uctxt->pc;
+	if(profMode == PROF_PAGE)
+		pc[0] = DOWN_TO_PAGE(pc[0]);
+	else if(pc[0] >= VMEM_1_BASE){
+		// Return Addresses Follow the Saved Frame Pointers up the User Stack
+		fp = (unsigned int *)uctxt->ebp;
+		for(i = 1; i < PROF_DEPTH && ProfReadable((unsigned int)fp); i++){
+			pc[i] = fp[1];
+			if(fp[0] <= (unsigned int)fp)
+				break;
+			fp = (unsigned int *)fp[0];
+		}
+	}
+	for(i = 0; i < PROF_DEPTH; i++)
+		hash = (hash ^ pc[i]) * 2654435761u;
+	hash >>= 16;
+	for(i = 0; i < PROF_BUCKETS; i++){
+		bucket = &prof->buckets[(hash + i) & (PROF_BUCKETS - 1)];
+		if(bucket->count == 0){
+			memcpy(bucket->pc, pc, sizeof(pc));
+			bucket->count = 1;
+			prof->used++;
+			return;
+		}
+		if(memcmp(bucket->pc, pc, sizeof(pc)) == 0){
+			bucket->count++;
+			return;
+		}
+	}
+	prof->lost++;
+}
+
+
+// Set the profiling mode, turning it on discards the previous profiles
+// Return the previous mode, -1 for a bad mode or no memory for the profiles
+int ProfControl(int mode)
+{
+	int old = profMode;
+	if(mode != PROF_OFF && mode != PROF_PAGE && mode != PROF_PC)
+		return -1;
+	if(mode != PROF_OFF){
+		if(profiles == NULL && (profiles = (Profile *)malloc(PROF_PROCS * sizeof(Profile))) == NULL)
+			return -1;
+		memset(profiles, 0, PROF_PROCS * sizeof(Profile));
+		profLost = 0;
+		profilesMode = mode;
+	}
+	profMode = mode;
+	KTrace(1, "ProfControl: mode %d\n", mode);
+	return old;
+}
+
+
+// Copy up to max buckets of the last profile of pid, return the number copied
+int ProfRead(int pid, ProfBucket *buf, int max)
+{
+	Profile *prof = NULL;
+	int i, count = 0;
+	if(profiles == NULL)
+		return 0;
+	for(i = 0; i < PROF_PROCS; i++){
+		if(profiles[i].pid == pid)
+			prof = &profiles[i];
+	}
+	if(prof == NULL)
+		return 0;
+	for(i = 0; i < PROF_BUCKETS && count < max; i++){
+		if(prof->buckets[i].count != 0)
+			memcpy(&buf[count++], &prof->buckets[i], sizeof(ProfBucket));
+	}
+	return count;
+}
+
+
+// Write the profiles to the host file DUMP_PREFIX path, return the number written
+int ProfDump(char *path)
+{
+	ProfHeader header;
+	int i, fd;
+	header.magic = PROF_MAGIC;
+	header.version = PROF_VERSION;
+	header.mode = profilesMode;
+	header.profiles = 0;
+	header.lost = profLost;
+	if(profiles != NULL){
+		for(i = 0; i < PROF_PROCS; i++){
+			if(profiles[i].pid != 0)
+				header.profiles++;
+		}
+	}
+	if((fd = DumpOpen(path)) < 0){
+		KTrace(0, "ProfDump: can't open file '%s%s'\n", DUMP_PREFIX, path);
+		return -1;
+	}
+	write(fd, &header, sizeof(header));
+	for(i = 0; i < PROF_PROCS && profiles != NULL; i++){
+		if(profiles[i].pid != 0)
+			write(fd, &profiles[i], sizeof(Profile));
+	}
+	close(fd);
+	return header.profiles;
+}
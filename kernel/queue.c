@@ -1,12 +1,13 @@
 #include "../include/hardware.h"
 #include "../include/queue.h"
+#include "../include/trace.h"
 
 
 int push(Queue *queue, void *content)
 {
 	Entry *entry = (Entry *)malloc(sizeof(Entry));
 	if(entry == NULL){
-		TracePrintf(0, "push: Not Enough Memory\n");
+		KTrace(0, "push: Not Enough Memory\n");
 		return -1;
 	}
 	entry->content = content;
@@ -0,0 +1,93 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/hardware.h"
+#include "../include/PCB.h"
+#include "../include/trace.h"
+
+extern PCB *curProc;
+extern unsigned int tickCount;
+
+int traceOn = 0;
+static TraceEvent *ring;
+// Events Logged, the Next Goes to ring[traceSeq % TRACE_EVENTS]
+static unsigned int traceSeq = 0;
+
+
+void TraceLog(int type, int arg0, int arg1)
+{
+	TraceEvent *e = &ring[traceSeq & (TRACE_EVENTS - 1)];
+	e->tick = tickCount;
+	e->seq = traceSeq++;
+	e->type = type;
+	e->pid = 0;
+	if(curProc != NULL)
+		e->pid = curProc->pid;
+	e->arg0 = arg0;
+	e->arg1 = arg1;
+}
+
+
+// Turn tracing on or off, the ring is allocated the first time
+// Return the previous state, -1 if there is no memory for the ring
+int TraceControl(int on)
+{
+	int old = traceOn;
+	if(on && ring == NULL){
+		ring = (TraceEvent *)malloc(TRACE_EVENTS * sizeof(TraceEvent));
+		if(ring == NULL)
+			return -1;
+	}
+	traceOn = (on != 0);
+	return old;
+}
+
+
+// Create the host file DUMP_PREFIX name for a dump, return its fd or -1
+// name may not leave the simulator's directory, nor name a file it does not own
+int DumpOpen(char *name)
+{
+	char path[sizeof(DUMP_PREFIX) + TRACE_PATH_LEN];
+	if(name[0] == '\0' || strchr(name, '/') != NULL || strstr(name, "..") != NULL
+		|| strlen(name) >= TRACE_PATH_LEN){
+		KTrace(0, "DumpOpen: Invalid Dump Name '%s'\n", name);
+		return -1;
+	}
+	strcpy(path, DUMP_PREFIX);
+	strcat(path, name);
+	return open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+
+// Write the events in the ring to the host file DUMP_PREFIX path, return the number written
+int TraceDump(char *path)
+{
+	TraceHeader header;
+	unsigned int first = 0;
+	unsigned int i;
+	int fd;
+	if(ring == NULL)
+		return 0;
+	if(traceSeq > TRACE_EVENTS)
+		first = traceSeq - TRACE_EVENTS;
+	if((fd = DumpOpen(path)) < 0){
+		KTrace(0, "TraceDump: can't open file '%s%s'\n", DUMP_PREFIX, path);
+		return -1;
+	}
+	header.magic = TRACE_MAGIC;
+	header.version = TRACE_VERSION;
+	header.count = traceSeq - first;
+	header.dropped = first;
+	write(fd, &header, sizeof(header));
+	// The Ring Wraps at Most Once between first and traceSeq
+	i = first & (TRACE_EVENTS - 1);
+	if(i + header.count > TRACE_EVENTS){
+		write(fd, &ring[i], (TRACE_EVENTS - i) * sizeof(TraceEvent));
+		write(fd, ring, (i + header.count - TRACE_EVENTS) * sizeof(TraceEvent));
+	}else
+		write(fd, &ring[i], header.count * sizeof(TraceEvent));
+	close(fd);
+	return header.count;
+}
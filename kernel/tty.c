@@ -0,0 +1,146 @@
+#include "../include/hardware.h"
+#include "../include/mm.h"
+#include "../include/PCB.h"
+#include "../include/queue.h"
+#include "../include/trace.h"
+#include "../include/tty.h"
+
+#include <string.h>
+
+extern Queue readyQueue;
+extern Queue transBlkQueue[NUM_TERMINALS];
+
+TxRing txRing[NUM_TERMINALS];
+RxRing rxRing[NUM_TERMINALS];
+// Lines That Do Not Fit Are Received Here and Dropped
+static char ttyDiscard[TERMINAL_MAX_LINE];
+static void StartTransmit(int);
+
+void InitTty(void)
+{
+	int i;
+	for(i = 0; i < NUM_TERMINALS; i++){
+		txRing[i].head = txRing[i].count = txRing[i].sending = 0;
+		txRing[i].bytes = txRing[i].blockedTicks = 0;
+		rxRing[i].first = rxRing[i].lines = rxRing[i].tail = 0;
+		rxRing[i].received = rxRing[i].drops = 0;
+	}
+}
+
+
+// Receive one line into contiguous free space of the receive ring
+// Return 0 if the ring is full and the line was dropped
+int TtyReceiveLine(int tty_id)
+{
+	RxRing *ring = &rxRing[tty_id];
+	int pos = -1;
+	if(ring->lines == 0)
+		pos = ring->tail = 0;
+	else if(ring->lines < TTY_RX_LINES){
+		int oldest = ring->start[ring->first];
+		if(ring->tail >= oldest){
+			if(TTY_RX_LEN - ring->tail >= TERMINAL_MAX_LINE)
+				pos = ring->tail;
+			else if(oldest > TERMINAL_MAX_LINE)
+				pos = 0;
+		}else if(oldest - ring->tail > TERMINAL_MAX_LINE)
+			pos = ring->tail;
+	}
+	if(pos == -1){
+		TtyReceive(tty_id, ttyDiscard, TERMINAL_MAX_LINE);
+		ring->drops++;
+		KTrace(1, "TtyReceiveLine: Terminal %d Overflow, %d Lines Dropped\n", tty_id, ring->drops);
+		return 0;
+	}
+	int count = TtyReceive(tty_id, &ring->buf[pos], TERMINAL_MAX_LINE);
+	int line = (ring->first + ring->lines) % TTY_RX_LINES;
+	ring->start[line] = pos;
+	ring->len[line] = count;
+	ring->lines++;
+	ring->tail = pos + count;
+	ring->received++;
+	return 1;
+}
+
+
+// Copy the oldest line, or its first len bytes, into buf
+// buf is in the region 1 of pageTable, or of curProc if pageTable is NULL
+// Return the number of bytes copied
+int TtyReadLine(int tty_id, void *buf, int len, struct pte *pageTable)
+{
+	RxRing *ring = &rxRing[tty_id];
+	int line = ring->first;
+	if(ring->lines == 0)
+		return 0;
+	if(len > ring->len[line])
+		len = ring->len[line];
+	if(pageTable == NULL)
+		memcpy(buf, &ring->buf[ring->start[line]], len);
+	else
+		CopyToPageTable(pageTable, buf, &ring->buf[ring->start[line]], len);
+	ring->start[line] += len;
+	ring->len[line] -= len;
+	if(ring->len[line] == 0){
+		ring->first = (ring->first + 1) % TTY_RX_LINES;
+		ring->lines--;
+	}
+	return len;
+}
+
+
+// Copy as much of buf as fits into the transmit ring and start the terminal if idle
+// Return the number of bytes queued
+int TtyQueueWrite(int tty_id, void *buf, int len)
+{
+	TxRing *ring = &txRing[tty_id];
+	int queued = 0;
+	while(len > 0 && ring->count < TTY_TX_LEN){
+		int tail = (ring->head + ring->count) % TTY_TX_LEN;
+		int count = TTY_TX_LEN - ring->count;
+		if(count > TTY_TX_LEN - tail)
+			count = TTY_TX_LEN - tail;
+		if(count > len)
+			count = len;
+		memcpy(&ring->buf[tail], buf, count);
+		ring->count += count;
+		buf += count;
+		len -= count;
+		queued += count;
+	}
+	if(ring->sending == 0)
+		StartTransmit(tty_id);
+	return queued;
+}
+
+
+// The terminal finished the last chunk, retire it and send the next one
+void TtyTransmitDone(int tty_id)
+{
+	TxRing *ring = &txRing[tty_id];
+	ring->head = (ring->head + ring->sending) % TTY_TX_LEN;
+	ring->count -= ring->sending;
+	ring->bytes += ring->sending;
+	ring->sending = 0;
+	StartTransmit(tty_id);
+	if(ring->count <= TTY_TX_LOW){
+		PCB *pcb;
+		while((pcb = pop(&transBlkQueue[tty_id])) != NULL)
+			WakePCB(pcb);
+	}
+}
+
+
+// Transmit the longest contiguous queued chunk, up to one terminal line
+static void StartTransmit(int tty_id)
+{
+	TxRing *ring = &txRing[tty_id];
+	int count = ring->count;
+	if(count == 0)
+		return;
+	if(count > TTY_TX_LEN - ring->head)
+		count = TTY_TX_LEN - ring->head;
+	if(count > TERMINAL_MAX_LINE)
+		count = TERMINAL_MAX_LINE;
+	ring->sending = count;
+	TtyTransmit(tty_id, &ring->buf[ring->head], count);
+}
@@ -0,0 +1,126 @@
+#include "../include/hardware.h"
+#include "../include/PCB.h"
+#include "../include/trace.h"
+#include "../include/uaccess.h"
+
+#include <string.h>
+
+extern PCB *curProc;
+
+static int PageAllowed(int page, int prot);
+static int CountTerminated(void *ptr, int size);
+
+
+static int PageAllowed(int page, int prot)
+{
+	return curProc->pageTableR1[page].valid != 0 && (curProc->pageTableR1[page].prot & prot) == prot;
+}
+
+
+// Whether [ptr, ptr + length) of region 1 is mapped with prot
+int ValidatePtr(void *ptr, int length, int prot)
+{
+	if(ptr == NULL || length < 0){
+		KTrace(0, "ValidatePtr: NULL PTR or Negative Length\n");
+		return -1;
+	}
+	if((int)ptr < VMEM_1_BASE){
+		KTrace(0, "ValidatePtr: PTR in Kernel Space\n");
+		return -1;
+	}else if((int)ptr >= VMEM_1_LIMIT || length > VMEM_1_LIMIT - (int)ptr){
+		KTrace(0, "ValidatePtr: PTR over User Space\n");
+		return -1;
+	}
+	int startPage = (int)(ptr - VMEM_1_BASE) >> PAGESHIFT;
+	int endPage = (int)(ptr - VMEM_1_BASE + length - 1) >> PAGESHIFT;
+	KTrace(3, "Validating Ptr %p with Length %d\n", ptr, length);
+	int page = startPage;
+	for(; page <= endPage; page++){
+		if(!PageAllowed(page, prot)){
+			KTrace(0, "ValidatePtr: Invalid Page 0x%x\n", page);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+// Count the elements of size bytes before the first all-zero one
+// Return -1 if it is not reached within readable pages
+static int CountTerminated(void *ptr, int size)
+{
+	int count = 0;
+	int page, end;
+	if(ptr == NULL || (int)ptr < VMEM_1_BASE || (int)ptr >= VMEM_1_LIMIT)
+		return -1;
+	// Highest Page Checked
+	int checked = ((int)(ptr - VMEM_1_BASE) >> PAGESHIFT) - 1;
+	while(1){
+		end = (int)ptr + size - 1;
+		if(end >= VMEM_1_LIMIT)
+			return -1;
+		page = (end - VMEM_1_BASE) >> PAGESHIFT;
+		while(checked < page){
+			if(!PageAllowed(++checked, PROT_READ)){
+				KTrace(0, "CountTerminated: Invalid Page 0x%x\n", checked);
+				return -1;
+			}
+		}
+		if(size == sizeof(char) && *(char *)ptr == '\0')
+			return count;
+		if(size == sizeof(char *) && *(char **)ptr == NULL)
+			return count;
+		ptr += size;
+		count++;
+	}
+}
+
+
+// Return the length of the string, -1 if it is not readable up to its NUL
+int ValidateString(char *str)
+{
+	return CountTerminated(str, sizeof(char));
+}
+
+
+// Return the number of pointers before the NULL one, -1 if not readable
+int ValidateVector(char **vec)
+{
+	return CountTerminated(vec, sizeof(char *));
+}
+
+
+// Copy the string at src to dst, at most max bytes including the NUL
+// Return the length copied without the NUL, -1 if unreadable or too long
+int StrncpyFromUser(char *dst, char *src, int max)
+{
+	int len = 0;
+	int offset, count;
+	if(src == NULL || (int)src < VMEM_1_BASE || (int)src >= VMEM_1_LIMIT)
+		return -1;
+	while(len < max){
+		if((int)src >= VMEM_1_LIMIT || !PageAllowed((int)(src - VMEM_1_BASE) >> PAGESHIFT, PROT_READ))
+			return -1;
+		// Scan the Rest of the Page
+		offset = (int)src & PAGEOFFSET;
+		count = PAGESIZE - offset;
+		if(count > max - len)
+			count = max - len;
+		while(count-- > 0){
+			if((*dst++ = *src++) == '\0')
+				return len;
+			len++;
+		}
+	}
+	return -1;
+}
+
+
+// Copy len bytes at src to dst, return len or -1 if unreadable
+int CopyFromUser(void *dst, void *src, int len)
+{
+	if(ValidatePtr(src, len, PROT_READ) == -1)
+		return -1;
+	memcpy(dst, src, len);
+	return len;
+}
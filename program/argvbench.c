@@ -0,0 +1,60 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define EXECS		20
+
+static int argCounts[] = {1, 10, 100, 1000};
+
+/*
+ * Exec this program with 1 to 1000 argument strings, the child exits at
+ * once.  Reports the mean Exec time from the kernel's system call
+ * statistics, in host microseconds, and the clock ticks per fork+exec.
+ * With an argument, that many execs are run per argument count.
+ */
+static void RunBench(char *prog, int n, int argc)
+{
+	SysStats before, after;
+	char **args = (char **)malloc((argc + 1) * sizeof(char *));
+	int i, status;
+	if(args == NULL)
+		return;
+	// The Child Knows Itself by argv[0]
+	args[0] = "child";
+	for(i = 1; i < argc; i++)
+		args[i] = "argument";
+	args[argc] = NULL;
+	GetSysStats(YALNIX_EXEC, &before);
+	int start = GetTicks();
+	for(i = 0; i < n; i++){
+		if(Fork() == 0){
+			Exec(prog, args);
+			Exit(1);
+		}
+		Wait(&status);
+	}
+	int ticks = GetTicks() - start;
+	GetSysStats(YALNIX_EXEC, &after);
+	int calls = after.calls - before.calls;
+	if(calls == 0)
+		calls = 1;
+	TtyPrintf(TTY_CONSOLE, "argvbench: %d args, exec %d usecs, fork+exec %d/100 ticks\n",
+		argc, (after.usecs - before.usecs) / calls, ticks * 100 / n);
+	free(args);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int i, n = EXECS;
+	if(strcmp(argv[0], "child") == 0)
+		Exit(0);
+	if(argc > 1)
+		n = atoi(argv[1]);
+	for(i = 0; i < sizeof(argCounts) / sizeof(int); i++)
+		RunBench(argv[0], n, argCounts[i]);
+	Exit(0);
+}
@@ -0,0 +1,63 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <stdlib.h>
+
+#define ROUNDS		8
+
+static int workingSets[] = {8, 16, 32, 64, 128, 256};
+
+/*
+ * Read a working set of w sectors ROUNDS times, in order and then in a
+ * shuffled order, and report the cache hit rate and mean ReadSector
+ * latency.  Run with and without bcache=N to compare capacities.
+ * With an argument, only that working set size is measured.
+ */
+static void RunBench(int w, int shuffle)
+{
+	char sector[SECTORSIZE];
+	BcacheStats before, after;
+	int i, r;
+	unsigned int seed = 12345;
+	GetBcacheStats(&before);
+	int start = GetTicks();
+	for(r = 0; r < ROUNDS; r++){
+		for(i = 0; i < w; i++){
+			int s = i;
+			if(shuffle){
+				seed = seed * 1103515245 + 12345;
+				s = (seed >> 8) % w;
+			}
+			ReadSector(s * 7 % NUMSECTORS, sector);
+		}
+	}
+	int ticks = GetTicks() - start;
+	GetBcacheStats(&after);
+	int hits = after.hits - before.hits;
+	int reads = after.reads - before.reads;
+	if(reads == 0)
+		reads = 1;
+	char *order = "sequential";
+	if(shuffle)
+		order = "random";
+	TtyPrintf(TTY_CONSOLE, "bcachebench: %d buffers, %d sector %s set, hit rate %d%%, %d ticks, mean read %d/100 ticks, max %d\n",
+		after.capacity, w, order, hits * 100 / reads, ticks,
+		(after.readTicks - before.readTicks) * 100 / reads, after.maxReadTicks);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int i;
+	if(argc > 1){
+		RunBench(atoi(argv[1]), 0);
+		RunBench(atoi(argv[1]), 1);
+		Exit(0);
+	}
+	for(i = 0; i < sizeof(workingSets) / sizeof(int); i++){
+		RunBench(workingSets[i], 0);
+		RunBench(workingSets[i], 1);
+	}
+	Exit(0);
+}
@@ -0,0 +1,98 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+#include "../include/yfs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LOOKUPS		200
+#define REPEATED	8
+
+static int dirSizes[] = {16, 128, 512, 1024};
+static char *formatArgs[] = {"program/yfs", "-f", NULL};
+static char *mountArgs[] = {"program/yfs", NULL};
+
+/*
+ * Fill directories of 16 to 1024 files, restart the server so its
+ * directory indexes are gone, then time per directory: the first lookup
+ * (which builds the index), LOOKUPS opens of random names, and LOOKUPS
+ * opens cycling over REPEATED paths (served by the path cache).
+ */
+static void StartServer(char **args)
+{
+	if(Fork() == 0){
+		Exec(args[0], args);
+		Exit(1);
+	}
+	while(SetReadAhead(-1) == ERROR)
+		Delay(1);
+}
+
+
+// "/d<size>/f<i>"
+static void MakePath(char *path, int size, int i)
+{
+	char digits[12];
+	int n;
+	char *p = path;
+	*p++ = '/';
+	*p++ = 'd';
+	for(n = 0; size > 0 || n == 0; size /= 10)
+		digits[n++] = '0' + size % 10;
+	while(n > 0)
+		*p++ = digits[--n];
+	if(i >= 0){
+		*p++ = '/';
+		*p++ = 'f';
+		for(n = 0; i > 0 || n == 0; i /= 10)
+			digits[n++] = '0' + i % 10;
+		while(n > 0)
+			*p++ = digits[--n];
+	}
+	*p = '\0';
+}
+
+
+static int TimeOpens(int size, int count, int distinct)
+{
+	char path[MAXPATHNAMELEN];
+	unsigned int seed = 777;
+	int i;
+	int start = GetTicks();
+	for(i = 0; i < count; i++){
+		seed = seed * 1103515245 + 12345;
+		MakePath(path, size, (seed >> 8) % distinct);
+		Close(Open(path));
+	}
+	return GetTicks() - start;
+}
+
+
+int main(int argc, char *argv[])
+{
+	char path[MAXPATHNAMELEN];
+	int d, i, status;
+	StartServer(formatArgs);
+	for(d = 0; d < sizeof(dirSizes) / sizeof(int); d++){
+		MakePath(path, dirSizes[d], -1);
+		MkDir(path);
+		for(i = 0; i < dirSizes[d]; i++){
+			MakePath(path, dirSizes[d], i);
+			Close(Create(path));
+		}
+	}
+	Shutdown();
+	Wait(&status);
+	StartServer(mountArgs);
+	for(d = 0; d < sizeof(dirSizes) / sizeof(int); d++){
+		int first = TimeOpens(dirSizes[d], 1, dirSizes[d]);
+		int random = TimeOpens(dirSizes[d], LOOKUPS, dirSizes[d]);
+		int repeated = TimeOpens(dirSizes[d], LOOKUPS, REPEATED);
+		TtyPrintf(TTY_CONSOLE, "dirbench: %d entries, first lookup %d ticks, %d random lookups %d ticks, %d repeated %d ticks\n",
+			dirSizes[d], first, LOOKUPS, random, LOOKUPS, repeated);
+	}
+	Shutdown();
+	Wait(&status);
+	Exit(0);
+}
@@ -0,0 +1,101 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define OPS_PER_PROC	32
+
+static char *policyName[] = {"fifo", "scan", "cscan"};
+static int sweepProcs[] = {1, 4, 16, 64};
+
+/*
+ * Fork n processes (default 4), each issuing OPS_PER_PROC sector reads
+ * at pseudo-random sectors, or writes with "write", so up to n requests
+ * are outstanding.  Report completed sectors per 100 ticks, head movement
+ * and latency percentiles from the kernel's log2 histogram.
+ * A policy name (fifo, scan, cscan) selects the disk scheduler first;
+ * "sweep" runs every policy with 1, 4, 16 and 64 processes.
+ */
+static int Percentile(DiskStats *before, DiskStats *after, int ops, int pct)
+{
+	int i, seen = 0;
+	for(i = 0; i < DISK_HIST_LEN; i++){
+		seen += after->latencyHist[i] - before->latencyHist[i];
+		if(seen * 100 >= ops * pct)
+			return 1 << i;
+	}
+	return 1 << (DISK_HIST_LEN - 1);
+}
+
+
+static void RunBench(int policy, int n, int write)
+{
+	int i, j, status;
+	DiskStats before, after;
+	SetDiskPolicy(policy);
+	GetDiskStats(&before);
+	int start = GetTicks();
+	for(i = 0; i < n; i++){
+		if(Fork() == 0){
+			char sector[SECTORSIZE];
+			unsigned int seed = GetPid() * 2654435761u;
+			memset(sector, i, SECTORSIZE);
+			for(j = 0; j < OPS_PER_PROC; j++){
+				seed = seed * 1103515245 + 12345;
+				int s = (seed >> 8) % NUMSECTORS;
+				if(write)
+					WriteSector(s, sector);
+				else
+					ReadSector(s, sector);
+			}
+			Exit(0);
+		}
+	}
+	for(i = 0; i < n; i++)
+		Wait(&status);
+	int ticks = GetTicks() - start;
+	if(ticks == 0)
+		ticks = 1;
+	GetDiskStats(&after);
+	int ops = (after.reads - before.reads) + (after.writes - before.writes);
+	if(ops == 0)
+		ops = 1;
+	TtyPrintf(TTY_CONSOLE, "diskbench: %s %d procs, %d sectors in %d ticks, %d sectors/100 ticks, seek %d sectors/op\n",
+		policyName[policy], n, ops, ticks, ops * 100 / ticks, (after.seekSectors - before.seekSectors) / ops);
+	TtyPrintf(TTY_CONSOLE, "diskbench: latency mean %d p50 < %d p99 < %d ticks, %d merged, %d starved\n",
+		(after.latencyTicks - before.latencyTicks) / ops, Percentile(&before, &after, ops, 50),
+		Percentile(&before, &after, ops, 99), after.merged - before.merged, after.starved - before.starved);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int n = 4, write = 0, sweep = 0, i, j;
+	int policy = SetDiskPolicy(DISK_CSCAN);
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "write") == 0)
+			write = 1;
+		else if(strcmp(argv[i], "sweep") == 0)
+			sweep = 1;
+		else if(strcmp(argv[i], "fifo") == 0)
+			policy = DISK_FIFO;
+		else if(strcmp(argv[i], "scan") == 0)
+			policy = DISK_SCAN;
+		else if(strcmp(argv[i], "cscan") == 0)
+			policy = DISK_CSCAN;
+		else
+			n = atoi(argv[i]);
+	}
+	if(n < 1)
+		n = 1;
+	if(sweep == 0){
+		RunBench(policy, n, write);
+		Exit(0);
+	}
+	for(i = DISK_FIFO; i <= DISK_CSCAN; i++)
+		for(j = 0; j < sizeof(sweepProcs) / sizeof(int); j++)
+			RunBench(i, sweepProcs[j], write);
+	Exit(0);
+}
@@ -0,0 +1,94 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define EXECS		50
+
+// Heap Pages of the Process Calling Exec, and Argument Pages of the New Image
+static int fromPages[] = {0, 16, 48};
+static int toPages[] = {0, 4, 8};
+
+/*
+ * Fork and Exec this program EXECS times, the child exits at once.
+ * Cold runs flush the exec cache before each Exec, warm runs leave it
+ * loaded.  A Fork and Exit loop without Exec is measured as the baseline,
+ * so the difference is the exec latency.
+ * Size transitions grow the heap of the child by from pages before Exec
+ * and pass an argument that takes to pages of the new stack, and report
+ * the frames Exec reused, allocated and freed.
+ * With an argument, that many execs are run per measurement.
+ */
+static int RunBench(char *prog, int n, int mode, int from, char *arg)
+{
+	char *args[4];
+	int i, status;
+	args[0] = prog;
+	args[1] = "child";
+	args[2] = arg;
+	args[3] = NULL;
+	int start = GetTicks();
+	for(i = 0; i < n; i++){
+		if(mode == 1)
+			FlushExecCache();
+		if(Fork() == 0){
+			if(from > 0)
+				malloc(from * PAGESIZE);
+			if(mode != 0)
+				Exec(prog, args);
+			Exit(0);
+		}
+		Wait(&status);
+	}
+	return GetTicks() - start;
+}
+
+
+static void RunTransition(char *prog, int n, int from, int to)
+{
+	ExecStats before, after;
+	char *arg = "";
+	if(to > 0){
+		arg = (char *)malloc(to * PAGESIZE);
+		memset(arg, 'x', to * PAGESIZE - 1);
+		arg[to * PAGESIZE - 1] = '\0';
+	}
+	int base = RunBench(prog, n, 0, from, arg);
+	GetExecStats(&before);
+	int ticks = RunBench(prog, n, 2, from, arg);
+	GetExecStats(&after);
+	TtyPrintf(TTY_CONSOLE, "execbench: %d heap pages -> %d arg pages, exec %d/100 ticks, reused %d, allocated %d, freed %d frames per exec\n",
+		from, to, (ticks - base) * 100 / n, (after.framesReused - before.framesReused) / n,
+		(after.framesAllocated - before.framesAllocated) / n, (after.framesFreed - before.framesFreed) / n);
+	if(to > 0)
+		free(arg);
+}
+
+
+int main(int argc, char *argv[])
+{
+	ExecStats before, after;
+	int i, j, n = EXECS;
+	if(argc > 1 && strcmp(argv[1], "child") == 0)
+		Exit(0);
+	if(argc > 1)
+		n = atoi(argv[1]);
+	int base = RunBench(argv[0], n, 0, 0, "");
+	GetExecStats(&before);
+	int cold = RunBench(argv[0], n, 1, 0, "");
+	RunBench(argv[0], 1, 2, 0, "");
+	int warm = RunBench(argv[0], n, 2, 0, "");
+	GetExecStats(&after);
+	TtyPrintf(TTY_CONSOLE, "execbench: %d execs, fork+exit %d/100 ticks each\n", n, base * 100 / n);
+	TtyPrintf(TTY_CONSOLE, "execbench: cold exec %d/100 ticks, warm exec %d/100 ticks more than fork+exit\n",
+		(cold - base) * 100 / n, (warm - base) * 100 / n);
+	TtyPrintf(TTY_CONSOLE, "execbench: %d hits, %d misses, %d images, %d text frames, %d data bytes cached\n",
+		after.hits - before.hits, after.misses - before.misses, after.images, after.textFrames, after.dataBytes);
+	for(i = 0; i < sizeof(fromPages) / sizeof(int); i++){
+		for(j = 0; j < sizeof(toPages) / sizeof(int); j++)
+			RunTransition(argv[0], n, fromPages[i], toPages[j]);
+	}
+	Exit(0);
+}
@@ -0,0 +1,81 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <stdlib.h>
+
+#define FORKS		200
+#define ROUNDS		1000
+
+/*
+ * Fork and Wait for FORKS children that exit at once, then bounce a
+ * byte ROUNDS times between parent and child over two pipes.  Reported
+ * in 1/100 clock ticks and in kernel host microseconds per operation,
+ * from the system call statistics.  Compare a default build with
+ * make release to see what compiled out traces save.
+ * With an argument, the counts are scaled by it.
+ */
+static void RunFork(int n)
+{
+	SysStats before, after;
+	int i, status;
+	GetSysStats(YALNIX_FORK, &before);
+	int start = GetTicks();
+	for(i = 0; i < n; i++){
+		if(Fork() == 0)
+			Exit(0);
+		Wait(&status);
+	}
+	int ticks = GetTicks() - start;
+	GetSysStats(YALNIX_FORK, &after);
+	// The Child Returns from Fork too
+	TtyPrintf(TTY_CONSOLE, "forkpipebench: fork+wait %d/100 ticks, fork %d usecs\n",
+		ticks * 100 / n, (after.usecs - before.usecs) / (after.calls - before.calls));
+}
+
+
+static void RunPipe(int n)
+{
+	SysStats readBefore, readAfter, writeBefore, writeAfter;
+	int ping, pong, i, status;
+	char c = 'x';
+	if(PipeInit(&ping) == ERROR || PipeInit(&pong) == ERROR)
+		return;
+	if(Fork() == 0){
+		for(i = 0; i < n; i++){
+			PipeRead(ping, &c, 1);
+			PipeWrite(pong, &c, 1);
+		}
+		Exit(0);
+	}
+	GetSysStats(YALNIX_PIPE_READ, &readBefore);
+	GetSysStats(YALNIX_PIPE_WRITE, &writeBefore);
+	int start = GetTicks();
+	for(i = 0; i < n; i++){
+		PipeWrite(ping, &c, 1);
+		PipeRead(pong, &c, 1);
+	}
+	int ticks = GetTicks() - start;
+	GetSysStats(YALNIX_PIPE_READ, &readAfter);
+	GetSysStats(YALNIX_PIPE_WRITE, &writeAfter);
+	Wait(&status);
+	TtyPrintf(TTY_CONSOLE, "forkpipebench: round trip %d/100 ticks, read %d usecs, write %d usecs\n",
+		ticks * 100 / n,
+		(readAfter.usecs - readBefore.usecs) / (readAfter.calls - readBefore.calls),
+		(writeAfter.usecs - writeBefore.usecs) / (writeAfter.calls - writeBefore.calls));
+	Reclaim(ping);
+	Reclaim(pong);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int scale = 1;
+	if(argc > 1)
+		scale = atoi(argv[1]);
+	if(scale < 1)
+		scale = 1;
+	RunFork(FORKS * scale);
+	RunPipe(ROUNDS * scale);
+	Exit(0);
+}
@@ -0,0 +1,67 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+#include "../include/yfs.h"
+
+#include <string.h>
+
+#define NFILES		4
+#define FILE_BLOCKS	64
+
+static char *goalArgs[] = {"program/yfs", "-f", NULL};
+static char *naiveArgs[] = {"program/yfs", "-f", "-n", NULL};
+
+/*
+ * On a freshly formatted disk, grow NFILES files one block at a time in
+ * turn, the worst case for a first-free allocator.  Report the mean
+ * extents per file and the time to read every file sequentially, for
+ * the goal and preallocation allocator and for first-free ("-n").
+ */
+static void RunBench(char **args)
+{
+	char buf[BLOCKSIZE];
+	char path[4] = "/f0";
+	int fds[NFILES];
+	int i, b, status, extents = 0, total = 0;
+	if(Fork() == 0){
+		Exec(args[0], args);
+		Exit(1);
+	}
+	while(SetReadAhead(-1) == ERROR)
+		Delay(1);
+	memset(buf, 'x', BLOCKSIZE);
+	for(i = 0; i < NFILES; i++){
+		path[2] = '0' + i;
+		fds[i] = Create(path);
+	}
+	for(b = 0; b < FILE_BLOCKS; b++)
+		for(i = 0; i < NFILES; i++)
+			Write(fds[i], buf, BLOCKSIZE);
+	for(i = 0; i < NFILES; i++)
+		extents += Extents(fds[i]);
+	int start = GetTicks();
+	for(i = 0; i < NFILES; i++){
+		Seek(fds[i], 0, SEEK_SET);
+		while(Read(fds[i], buf, BLOCKSIZE) > 0)
+			total += BLOCKSIZE;
+		Close(fds[i]);
+	}
+	int ticks = GetTicks() - start;
+	if(ticks == 0)
+		ticks = 1;
+	char *name = "goal";
+	if(args == naiveArgs)
+		name = "first-free";
+	TtyPrintf(TTY_CONSOLE, "fragbench: %s, %d files of %d blocks, %d.%02d extents/file, read %d bytes in %d ticks, %d bytes/100 ticks\n",
+		name, NFILES, FILE_BLOCKS, extents / NFILES, extents * 100 / NFILES % 100, total, ticks, total * 100 / ticks);
+	Shutdown();
+	Wait(&status);
+}
+
+
+int main(int argc, char *argv[])
+{
+	RunBench(naiveArgs);
+	RunBench(goalArgs);
+	Exit(0);
+}
@@ -0,0 +1,67 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <stdlib.h>
+
+#define INTERVAL	10
+
+static KStatSnap snap;
+
+static char *stateNames[] = {"run", "ready", "delay", "tty", "wait", "blocked"};
+
+/*
+ * Print a kernel statistics snapshot, "kstat INTERVAL [COUNT]" prints
+ * one every INTERVAL clock ticks, COUNT times or until killed.  The
+ * snapshot comes from the kernel's KStat call, so no trace build is
+ * needed to watch memory, queues, IPC objects and terminals.
+ */
+static void Render(void)
+{
+	int i, n;
+	TtyPrintf(TTY_CONSOLE, "kstat: tick %d, %d switches, frames %d free %d used %d shared of %d\n",
+		snap.ticks, snap.switches, snap.freeFrames, snap.usedFrames, snap.sharedFrames, snap.totalFrames);
+	TtyPrintf(TTY_CONSOLE, "  queues: %d ready, %d delayed, %d blocked\n", snap.ready, snap.delayed, snap.blocked);
+	TtyPrintf(TTY_CONSOLE, "  ipc: %d pipes (%d bytes), %d locks, %d cvars, %d rwlocks, %d shms, %d waiters\n",
+		snap.pipes, snap.pipeBytes, snap.locks, snap.cvars, snap.rwlocks, snap.shms, snap.ipcWaiters);
+	for(i = 0; i < NUM_TERMINALS; i++){
+		TtyPrintf(TTY_CONSOLE, "  tty%d: %d tx bytes, %d rx lines, %d readers, %d writers\n", i,
+			snap.tty[i].txQueued, snap.tty[i].rxLines, snap.tty[i].readers, snap.tty[i].writers);
+	}
+	n = snap.procs;
+	if(n > KSTAT_PROCS)
+		n = KSTAT_PROCS;
+	TtyPrintf(TTY_CONSOLE, "  %d processes: pid ppid group state resident shared brk stack name\n", snap.procs);
+	for(i = 0; i < n; i++){
+		KStatProc *proc = &snap.proc[i];
+		TtyPrintf(TTY_CONSOLE, "  %d %d %d %s %d %d %d %d %s\n", proc->pid, proc->ppid, proc->group,
+			stateNames[proc->state], proc->residentPages, proc->sharedPages,
+			proc->brkPages, proc->stackPages, proc->name);
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	int interval = INTERVAL, count = 1, i;
+	if(argc > 1){
+		interval = atoi(argv[1]);
+		count = 0;
+	}
+	if(argc > 2)
+		count = atoi(argv[2]);
+	for(i = 0; count == 0 || i < count; i++){
+		if(i > 0)
+			Delay(interval);
+		if(KStat(&snap, sizeof(snap)) == ERROR){
+			TtyPrintf(TTY_CONSOLE, "kstat: KStat failed\n");
+			Exit(1);
+		}
+		if(snap.version != KSTAT_VERSION){
+			TtyPrintf(TTY_CONSOLE, "kstat: snapshot version %d, expected %d\n", snap.version, KSTAT_VERSION);
+			Exit(1);
+		}
+		Render();
+	}
+	Exit(0);
+}
@@ -0,0 +1,75 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+#include "../include/yfs.h"
+
+#include <string.h>
+
+// The Largest File: 13 Direct Blocks and One Indirect Block
+#define FILE_BLOCKS	(NUM_DIRECT + BLOCKSIZE / sizeof(int))
+#define FILE_SIZE	(FILE_BLOCKS * BLOCKSIZE)
+#define CHUNK		4096
+
+static char *serverArgs[] = {"program/yfs", "-f", NULL};
+
+/*
+ * Scan the largest YFS file (FILE_SIZE bytes) with Read in CHUNK byte
+ * pieces and through Mmap, and report the ticks of each.  Then store
+ * through the mapping, unmap, and check that Read sees the stores.
+ */
+int main(int argc, char *argv[])
+{
+	char buf[CHUNK];
+	int i, n, status, sum = 0;
+	if(Fork() == 0){
+		Exec(serverArgs[0], serverArgs);
+		Exit(1);
+	}
+	while(SetReadAhead(-1) == ERROR)
+		Delay(1);
+	int fd = Create("/mapped");
+	for(i = 0; i < CHUNK; i++)
+		buf[i] = i;
+	for(i = 0; i < FILE_SIZE; i += n){
+		n = FILE_SIZE - i;
+		if(n > CHUNK)
+			n = CHUNK;
+		Write(fd, buf, n);
+	}
+	Seek(fd, 0, SEEK_SET);
+	int start = GetTicks();
+	while((n = Read(fd, buf, CHUNK)) > 0)
+		for(i = 0; i < n; i++)
+			sum += buf[i];
+	int readTicks = GetTicks() - start;
+	int readSum = sum;
+	sum = 0;
+	start = GetTicks();
+	char *map = Mmap(fd, 0, FILE_SIZE);
+	if(map == NULL){
+		TtyPrintf(TTY_CONSOLE, "mmapbench: Mmap Failed\n");
+		Exit(1);
+	}
+	for(i = 0; i < FILE_SIZE; i++)
+		sum += map[i];
+	int mapTicks = GetTicks() - start;
+	char *check = "match";
+	if(readSum != sum)
+		check = "differ";
+	TtyPrintf(TTY_CONSOLE, "mmapbench: %d bytes, read() scan %d ticks, mmap scan %d ticks, sums %s\n",
+		FILE_SIZE, readTicks, mapTicks, check);
+	for(i = 0; i < FILE_SIZE; i += PAGESIZE)
+		map[i] = 'M';
+	Munmap(map);
+	int bad = 0;
+	for(i = 0; i < FILE_SIZE; i += PAGESIZE){
+		Seek(fd, i, SEEK_SET);
+		if(Read(fd, buf, 1) != 1 || buf[0] != 'M')
+			bad++;
+	}
+	TtyPrintf(TTY_CONSOLE, "mmapbench: %d stored pages not written back\n", bad);
+	Close(fd);
+	Shutdown();
+	Wait(&status);
+	Exit(0);
+}
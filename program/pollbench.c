@@ -0,0 +1,76 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#define MAX_STREAMS	16
+#define MSG_LEN		64
+#define MSG_COUNT	64
+
+/*
+ * One process multiplexes n pipes with Poll, each pipe fed by its own
+ * producer.  Prints the bytes consumed per clock tick for each n.
+ */
+static void Producer(int pipe_id)
+{
+	char msg[MSG_LEN];
+	int i;
+	for(i = 0; i < MSG_LEN; i++)
+		msg[i] = 'a' + pipe_id % 26;
+	for(i = 0; i < MSG_COUNT; i++)
+		PipeWrite(pipe_id, msg, MSG_LEN);
+	Exit(0);
+}
+
+
+static void RunStreams(int n)
+{
+	PollFd fds[MAX_STREAMS];
+	int left[MAX_STREAMS];
+	char buf[MSG_LEN];
+	int i, status, ready, active = n;
+	int polls = 0;
+
+	for(i = 0; i < n; i++){
+		PipeInit(&fds[i].id);
+		fds[i].events = POLL_PIPE_IN;
+		left[i] = MSG_COUNT;
+	}
+	int start = GetTicks();
+	for(i = 0; i < n; i++){
+		if(Fork() == 0)
+			Producer(fds[i].id);
+	}
+	while(active > 0){
+		ready = Poll(fds, n, -1);
+		polls++;
+		if(ready <= 0)
+			break;
+		for(i = 0; i < n; i++){
+			if((fds[i].revents & POLL_PIPE_IN) && left[i] > 0){
+				PipeRead(fds[i].id, buf, MSG_LEN);
+				if(--left[i] == 0){
+					fds[i].events = 0;
+					active--;
+				}
+			}
+		}
+	}
+	int ticks = GetTicks() - start;
+	for(i = 0; i < n; i++){
+		Wait(&status);
+		Reclaim(fds[i].id);
+	}
+	if(ticks == 0)
+		ticks = 1;
+	TtyPrintf(TTY_CONSOLE, "pollbench: streams %2d, polls %5d, ticks %5d, bytes/tick %d\n",
+		n, polls, ticks, n * MSG_COUNT * MSG_LEN / ticks);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int n;
+	for(n = 1; n <= MAX_STREAMS; n *= 2)
+		RunStreams(n);
+	Exit(0);
+}
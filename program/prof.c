@@ -0,0 +1,57 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Control the clock driven profiler: "prof page" or "prof pc" starts new
+ * profiles, "prof off" stops sampling, "prof show PID" prints the
+ * buckets of PID and "prof dump FILE" writes every profile to dump-FILE on
+ * the host, which tools/profsym.py symbolizes.
+ */
+static ProfBucket buckets[PROF_BUCKETS];
+
+static void Show(int pid)
+{
+	int i, j, n = ReadProfile(pid, buckets, sizeof(buckets) / sizeof(ProfBucket));
+	if(n == ERROR){
+		TtyPrintf(TTY_CONSOLE, "prof: can't read the profile of %d\n", pid);
+		return;
+	}
+	TtyPrintf(TTY_CONSOLE, "prof: pid %d, %d buckets, count and pcs\n", pid, n);
+	for(i = 0; i < n; i++){
+		TtyPrintf(TTY_CONSOLE, "%d", buckets[i].count);
+		for(j = 0; j < PROF_DEPTH && buckets[i].pc[j] != 0; j++)
+			TtyPrintf(TTY_CONSOLE, " 0x%x", buckets[i].pc[j]);
+		TtyPrintf(TTY_CONSOLE, "\n");
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	int ret = 0;
+	if(argc > 1 && strcmp(argv[1], "page") == 0)
+		ret = SetProfile(PROF_PAGE);
+	else if(argc > 1 && strcmp(argv[1], "pc") == 0)
+		ret = SetProfile(PROF_PC);
+	else if(argc > 1 && strcmp(argv[1], "off") == 0)
+		ret = SetProfile(PROF_OFF);
+	else if(argc > 2 && strcmp(argv[1], "show") == 0)
+		Show(atoi(argv[2]));
+	else if(argc > 2 && strcmp(argv[1], "dump") == 0){
+		ret = DumpProfile(argv[2]);
+		if(ret != ERROR)
+			TtyPrintf(TTY_CONSOLE, "prof: %d profiles written to dump-%s\n", ret, argv[2]);
+	}else{
+		TtyPrintf(TTY_CONSOLE, "usage: prof page|pc|off|show PID|dump FILE\n");
+		Exit(1);
+	}
+	if(ret == ERROR){
+		TtyPrintf(TTY_CONSOLE, "prof: %s failed\n", argv[1]);
+		Exit(1);
+	}
+	Exit(0);
+}
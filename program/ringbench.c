@@ -0,0 +1,71 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#define MESSAGES	2048
+#define MSG_LEN		16
+
+/*
+ * Send MESSAGES small pipe writes to a draining child, once with one
+ * trap per write and once batched through the submission ring.
+ */
+static Ring ring;
+
+static void Drain(int pipe_id)
+{
+	char buf[MSG_LEN * 64];
+	int left = MESSAGES * MSG_LEN;
+	while(left > 0)
+		left -= PipeReadEx(pipe_id, buf, sizeof(buf), IO_PARTIAL);
+	Exit(0);
+}
+
+
+static int Run(int batched, int *traps)
+{
+	char msg[MSG_LEN];
+	int pipe_id, status, sent, n;
+	PipeInit(&pipe_id);
+	if(Fork() == 0)
+		Drain(pipe_id);
+	*traps = 0;
+	int start = GetTicks();
+	if(!batched){
+		for(sent = 0; sent < MESSAGES; sent++){
+			PipeWrite(pipe_id, msg, MSG_LEN);
+			(*traps)++;
+		}
+	}else{
+		RingSetup(&ring);
+		for(sent = 0; sent < MESSAGES; ){
+			for(n = 0; n < RING_ENTRIES && sent + n < MESSAGES; n++){
+				RingSqe *sqe = &ring.sq[ring.sqTail % RING_ENTRIES];
+				sqe->code = YALNIX_PIPE_WRITE;
+				sqe->args[0] = pipe_id;
+				sqe->args[1] = (int)msg;
+				sqe->args[2] = MSG_LEN;
+				sqe->tag = sent + n;
+				ring.sqTail++;
+			}
+			sent += RingEnter(n);
+			(*traps)++;
+			ring.cqHead = ring.cqTail;
+		}
+	}
+	int ticks = GetTicks() - start;
+	Wait(&status);
+	Reclaim(pipe_id);
+	return ticks;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int traps, ticks;
+	ticks = Run(0, &traps);
+	TtyPrintf(TTY_CONSOLE, "ringbench: direct  %d writes, %d traps, %d ticks\n", MESSAGES, traps, ticks);
+	ticks = Run(1, &traps);
+	TtyPrintf(TTY_CONSOLE, "ringbench: batched %d writes, %d traps (%d ops/trap), %d ticks\n",
+		MESSAGES, traps, MESSAGES / traps, ticks);
+	Exit(0);
+}
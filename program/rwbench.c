@@ -0,0 +1,76 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#define WORKERS		4
+#define OPS		200
+#define HOLD_WORK	2000
+
+/*
+ * WORKERS processes run OPS critical sections each, writing in
+ * writePct percent of them.  The mix runs once over a Lock and once
+ * over a reader-writer lock and prints the ticks of each.
+ */
+static volatile int sink;
+
+static void Work(void)
+{
+	int i;
+	for(i = 0; i < HOLD_WORK; i++)
+		sink += i;
+}
+
+
+static void Worker(int id, int useRW, int lock_id, int writePct)
+{
+	unsigned int seed = 12345 + id;
+	int i, write;
+	for(i = 0; i < OPS; i++){
+		seed = seed * 1103515245 + 12345;
+		write = (int)((seed >> 16) % 100) < writePct;
+		if(useRW){
+			RWAcquire(lock_id, write ? RW_EXCLUSIVE : RW_SHARED);
+			Work();
+			RWRelease(lock_id);
+		}else{
+			Acquire(lock_id);
+			Work();
+			Release(lock_id);
+		}
+	}
+	Exit(0);
+}
+
+
+static int RunMix(int useRW, int writePct)
+{
+	int lock_id, i, status;
+	if(useRW)
+		RWLockInit(&lock_id);
+	else
+		LockInit(&lock_id);
+	int start = GetTicks();
+	for(i = 0; i < WORKERS; i++){
+		if(Fork() == 0)
+			Worker(i, useRW, lock_id, writePct);
+	}
+	for(i = 0; i < WORKERS; i++)
+		Wait(&status);
+	int ticks = GetTicks() - start;
+	Reclaim(lock_id);
+	return ticks;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int mixes[2] = {1, 10};
+	int i;
+	for(i = 0; i < 2; i++){
+		int lockTicks = RunMix(0, mixes[i]);
+		int rwTicks = RunMix(1, mixes[i]);
+		TtyPrintf(TTY_CONSOLE, "rwbench: %d/%d read/write, Lock %d ticks, RWLock %d ticks\n",
+			100 - mixes[i], mixes[i], lockTicks, rwTicks);
+	}
+	Exit(0);
+}
@@ -0,0 +1,84 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <string.h>
+
+#define TOTAL_BYTES	(256 * 1024)
+#define CHUNK		PAGESIZE
+#define SLOTS		2
+
+/*
+ * Move TOTAL_BYTES from a producer to a consumer, once through a pipe
+ * and once through a shared memory ring whose slots are handed over
+ * with one-byte tokens on a pair of pipes.
+ */
+static char chunk[CHUNK];
+
+static int PipeTransferTicks(void)
+{
+	int pipe_id, status, done;
+	PipeInit(&pipe_id);
+	int start = GetTicks();
+	if(Fork() == 0){
+		for(done = 0; done < TOTAL_BYTES; done += CHUNK)
+			PipeWrite(pipe_id, chunk, CHUNK);
+		Exit(0);
+	}
+	for(done = 0; done < TOTAL_BYTES; done += CHUNK)
+		PipeRead(pipe_id, chunk, CHUNK);
+	int ticks = GetTicks() - start;
+	Wait(&status);
+	Reclaim(pipe_id);
+	return ticks;
+}
+
+
+static int ShmTransferTicks(void)
+{
+	int shm_id, full_id, empty_id, status, done, slot;
+	char token = 0;
+	char *ring = (char *)ShmInit(&shm_id, SLOTS * CHUNK);
+	if(ring == (char *)ERROR){
+		TtyPrintf(TTY_CONSOLE, "shmbench: ShmInit failed\n");
+		return -1;
+	}
+	PipeInit(&full_id);
+	PipeInit(&empty_id);
+	for(slot = 0; slot < SLOTS; slot++)
+		PipeWrite(empty_id, &token, 1);
+	int start = GetTicks();
+	if(Fork() == 0){
+		for(done = 0, slot = 0; done < TOTAL_BYTES; done += CHUNK, slot = (slot + 1) % SLOTS){
+			PipeRead(empty_id, &token, 1);
+			memcpy(ring + slot * CHUNK, chunk, CHUNK);
+			PipeWrite(full_id, &token, 1);
+		}
+		Exit(0);
+	}
+	for(done = 0, slot = 0; done < TOTAL_BYTES; done += CHUNK, slot = (slot + 1) % SLOTS){
+		PipeRead(full_id, &token, 1);
+		memcpy(chunk, ring + slot * CHUNK, CHUNK);
+		PipeWrite(empty_id, &token, 1);
+	}
+	int ticks = GetTicks() - start;
+	Wait(&status);
+	Reclaim(full_id);
+	Reclaim(empty_id);
+	Reclaim(shm_id);
+	return ticks;
+}
+
+
+int main(int argc, char *argv[])
+{
+	memset(chunk, 'x', CHUNK);
+	int pipeTicks = PipeTransferTicks();
+	int shmTicks = ShmTransferTicks();
+	TtyPrintf(TTY_CONSOLE, "shmbench: %d bytes, pipe %d ticks, shm %d ticks\n",
+		TOTAL_BYTES, pipeTicks, shmTicks);
+	if(pipeTicks > 0 && shmTicks > 0)
+		TtyPrintf(TTY_CONSOLE, "shmbench: pipe %d bytes/tick, shm %d bytes/tick\n",
+			TOTAL_BYTES / pipeTicks, TOTAL_BYTES / shmTicks);
+	Exit(0);
+}
@@ -0,0 +1,76 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CHILDREN	20
+
+#define MODE_FORK	0	// Fork, then Exec in the child
+#define MODE_VFORK	1	// VFork, then Exec in the child
+#define MODE_SPAWN	2
+
+static int heapPages[] = {0, 16, 32, 64};
+
+/*
+ * Start CHILDREN copies of this program, which exit at once, and wait
+ * for each.  The parent first grows its heap, which Fork copies and
+ * VFork and Spawn do not.  Reported per child in 1/100 clock ticks.
+ * With an argument, that many children are started per measurement.
+ */
+static int RunBench(char *prog, int n, int mode)
+{
+	char *args[3];
+	int i, status;
+	args[0] = prog;
+	args[1] = "child";
+	args[2] = NULL;
+	int start = GetTicks();
+	for(i = 0; i < n; i++){
+		if(mode == MODE_SPAWN){
+			if(Spawn(prog, args) == ERROR)
+				break;
+		}else if(mode == MODE_VFORK){
+			if(VFork() == 0){
+				Exec(prog, args);
+				Exit(1);
+			}
+		}else{
+			if(Fork() == 0){
+				Exec(prog, args);
+				Exit(1);
+			}
+		}
+		Wait(&status);
+	}
+	return (GetTicks() - start) * 100 / n;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int i, n = CHILDREN;
+	char *heap = NULL;
+	int pages = 0;
+	if(argc > 1 && strcmp(argv[1], "child") == 0)
+		Exit(0);
+	if(argc > 1)
+		n = atoi(argv[1]);
+	// Load the Exec Cache
+	RunBench(argv[0], 1, MODE_SPAWN);
+	for(i = 0; i < sizeof(heapPages) / sizeof(int); i++){
+		if(heapPages[i] > pages){
+			heap = malloc((heapPages[i] - pages) * PAGESIZE);
+			if(heap == NULL)
+				break;
+			pages = heapPages[i];
+		}
+		int fork = RunBench(argv[0], n, MODE_FORK);
+		int vfork = RunBench(argv[0], n, MODE_VFORK);
+		int spawn = RunBench(argv[0], n, MODE_SPAWN);
+		TtyPrintf(TTY_CONSOLE, "spawnbench: %d heap pages, fork+exec %d/100, vfork+exec %d/100, spawn %d/100 ticks per child\n",
+			pages, fork, vfork, spawn);
+	}
+	Exit(0);
+}
@@ -0,0 +1,57 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <string.h>
+
+typedef struct{
+	int code;
+	char *name;
+}SysName;
+
+static SysName names[] = {
+	{YALNIX_FORK, "Fork"}, {YALNIX_EXEC, "Exec"}, {YALNIX_EXIT, "Exit"},
+	{YALNIX_WAIT, "Wait"}, {YALNIX_GETPID, "GetPid"}, {YALNIX_BRK, "Brk"},
+	{YALNIX_DELAY, "Delay"}, {YALNIX_TTY_READ, "TtyRead"}, {YALNIX_TTY_WRITE, "TtyWrite"},
+	{YALNIX_REGISTER, "Register"}, {YALNIX_SEND, "Send"}, {YALNIX_RECEIVE, "Receive"},
+	{YALNIX_REPLY, "Reply"}, {YALNIX_COPY_FROM, "CopyFrom"}, {YALNIX_COPY_TO, "CopyTo"},
+	{YALNIX_READ_SECTOR, "ReadSector"}, {YALNIX_WRITE_SECTOR, "WriteSector"},
+	{YALNIX_PIPE_INIT, "PipeInit"}, {YALNIX_PIPE_READ, "PipeRead"}, {YALNIX_PIPE_WRITE, "PipeWrite"},
+	{YALNIX_LOCK_INIT, "LockInit"}, {YALNIX_LOCK_ACQUIRE, "Acquire"}, {YALNIX_LOCK_RELEASE, "Release"},
+	{YALNIX_CVAR_INIT, "CvarInit"}, {YALNIX_CVAR_SIGNAL, "CvarSignal"},
+	{YALNIX_CVAR_BROADCAST, "CvarBroadcast"}, {YALNIX_CVAR_WAIT, "CvarWait"},
+	{YALNIX_RECLAIM, "Reclaim"}, {YALNIX_CUSTOM_0, "Custom0"}, {YALNIX_CUSTOM_1, "Custom1"},
+	{YALNIX_CUSTOM_2, "Custom2"},
+};
+
+/*
+ * Dump the kernel's per system call statistics to the console: calls,
+ * errors, mean latency and the log2 latency histograms, bucket i
+ * counting latencies below 2^i ticks or host microseconds.
+ * With -r, the statistics are reset after the dump.
+ */
+static void PrintHist(char *unit, unsigned int *hist)
+{
+	TtyPrintf(TTY_CONSOLE, "    %s %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d\n", unit,
+		hist[0], hist[1], hist[2], hist[3], hist[4], hist[5], hist[6], hist[7],
+		hist[8], hist[9], hist[10], hist[11], hist[12], hist[13], hist[14], hist[15]);
+}
+
+
+int main(int argc, char *argv[])
+{
+	SysStats stats;
+	int i;
+	TtyPrintf(TTY_CONSOLE, "sysstats: call, calls, errors, mean ticks/100, mean usecs\n");
+	for(i = 0; i < sizeof(names) / sizeof(SysName); i++){
+		if(GetSysStats(names[i].code, &stats) == ERROR || stats.calls == 0)
+			continue;
+		TtyPrintf(TTY_CONSOLE, "%s %d %d %d %d\n", names[i].name, stats.calls, stats.errors,
+			stats.ticks * 100 / stats.calls, stats.usecs / stats.calls);
+		PrintHist("ticks:", stats.tickHist);
+		PrintHist("usecs:", stats.usecHist);
+	}
+	if(argc > 1 && strcmp(argv[1], "-r") == 0)
+		ResetSysStats();
+	Exit(0);
+}
@@ -0,0 +1,123 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <stdlib.h>
+
+#define ELEMENTS	16384
+#define PASSES		20
+#define MAX_WORKERS	8
+
+static int workerCounts[] = {1, 2, 4, 8};
+
+/*
+ * Sum an array of ELEMENTS ints PASSES times, split among 1 to 8
+ * workers.  Threads read the shared array and leave their sums in a
+ * shared slot, forked children read their copy of the array and send
+ * their sums back through a pipe.  Reported in clock ticks per run,
+ * with the frames the workers took once all were started.  With an
+ * argument, PASSES is scaled by it.
+ */
+static int *array;
+static int sums[MAX_WORKERS];
+static int passes = PASSES;
+static int workers;
+
+static KStatSnap snap;
+
+static int UsedFrames(void)
+{
+	if(KStat(&snap, sizeof(snap)) == ERROR)
+		return 0;
+	return snap.usedFrames;
+}
+
+
+static int Sum(int worker)
+{
+	int per = ELEMENTS / workers;
+	int i, pass, sum = 0;
+	for(pass = 0; pass < passes; pass++){
+		for(i = worker * per; i < (worker + 1) * per; i++)
+			sum += array[i];
+	}
+	return sum;
+}
+
+
+static int Worker(void *arg)
+{
+	int worker = (int)arg;
+	sums[worker] = Sum(worker);
+	return 0;
+}
+
+
+static int RunThreads(int *total, int *frames)
+{
+	int tids[MAX_WORKERS];
+	int i, status;
+	int used = UsedFrames();
+	int start = GetTicks();
+	for(i = 0; i < workers; i++)
+		tids[i] = ThreadCreate(Worker, i);
+	*frames = UsedFrames() - used;
+	*total = 0;
+	for(i = 0; i < workers; i++){
+		if(tids[i] == ERROR || ThreadJoin(tids[i], &status) == ERROR)
+			return -1;
+		*total += sums[i];
+	}
+	return GetTicks() - start;
+}
+
+
+static int RunForks(int *total, int *frames)
+{
+	int i, sum, status, pipe_id;
+	if(PipeInit(&pipe_id) == ERROR)
+		return -1;
+	int used = UsedFrames();
+	int start = GetTicks();
+	for(i = 0; i < workers; i++){
+		if(Fork() == 0){
+			sum = Sum(i);
+			PipeWrite(pipe_id, &sum, sizeof(int));
+			Exit(0);
+		}
+	}
+	*frames = UsedFrames() - used;
+	*total = 0;
+	for(i = 0; i < workers; i++){
+		PipeRead(pipe_id, &sum, sizeof(int));
+		*total += sum;
+	}
+	for(i = 0; i < workers; i++)
+		Wait(&status);
+	int ticks = GetTicks() - start;
+	Reclaim(pipe_id);
+	return ticks;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int i, threadTicks, forkTicks, threadTotal, forkTotal, threadFrames, forkFrames;
+	if(argc > 1)
+		passes = PASSES * atoi(argv[1]);
+	array = (int *)malloc(ELEMENTS * sizeof(int));
+	if(array == NULL)
+		Exit(1);
+	for(i = 0; i < ELEMENTS; i++)
+		array[i] = i & 0xFF;
+	for(i = 0; i < sizeof(workerCounts) / sizeof(int); i++){
+		workers = workerCounts[i];
+		threadTicks = RunThreads(&threadTotal, &threadFrames);
+		forkTicks = RunForks(&forkTotal, &forkFrames);
+		if(threadTotal != forkTotal)
+			TtyPrintf(TTY_CONSOLE, "threadbench: sums differ, %d and %d\n", threadTotal, forkTotal);
+		TtyPrintf(TTY_CONSOLE, "threadbench: %d workers, threads %d ticks %d frames, fork+pipe %d ticks %d frames\n",
+			workers, threadTicks, threadFrames, forkTicks, forkFrames);
+	}
+	Exit(0);
+}
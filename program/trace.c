@@ -0,0 +1,32 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <string.h>
+
+/*
+ * Control the kernel event trace: "trace on", "trace off", or
+ * "trace dump FILE" to write the ring to dump-FILE on the host, which
+ * tools/trace2chrome.py turns into a Chrome trace / Perfetto JSON file.
+ */
+int main(int argc, char *argv[])
+{
+	int ret;
+	if(argc > 1 && strcmp(argv[1], "on") == 0)
+		ret = SetTrace(1);
+	else if(argc > 1 && strcmp(argv[1], "off") == 0)
+		ret = SetTrace(0);
+	else if(argc > 2 && strcmp(argv[1], "dump") == 0){
+		ret = DumpTrace(argv[2]);
+		if(ret != ERROR)
+			TtyPrintf(TTY_CONSOLE, "trace: %d events written to dump-%s\n", ret, argv[2]);
+	}else{
+		TtyPrintf(TTY_CONSOLE, "usage: trace on|off|dump FILE\n");
+		Exit(1);
+	}
+	if(ret == ERROR){
+		TtyPrintf(TTY_CONSOLE, "trace: %s failed\n", argv[1]);
+		Exit(1);
+	}
+	Exit(0);
+}
@@ -0,0 +1,94 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TOTAL_BYTES	(32 * 1024)
+#define WRITE_LEN	256
+#define RX_TICKS	100
+#define READER_LINES	4
+
+/*
+ * Write TOTAL_BYTES to terminal 1 in small writes and report the
+ * transmit rate and how long the writer spent blocked.
+ * With "rx", read whatever terminal 1 receives for RX_TICKS ticks
+ * while sleeping between reads, and report lines received and dropped.
+ * With "readers n", block n readers on terminal 1 until each got
+ * READER_LINES lines, and report context switches per received line.
+ */
+static void ReceiveBench(void)
+{
+	char buf[TERMINAL_MAX_LINE];
+	TtyStats before, after;
+	GetTtyStats(TTY_1, &before);
+	int start = GetTicks();
+	while(GetTicks() - start < RX_TICKS){
+		while(TtyReadEx(TTY_1, buf, sizeof(buf), IO_NONBLOCK | IO_PARTIAL) > 0);
+		Delay(5);
+	}
+	GetTtyStats(TTY_1, &after);
+	TtyPrintf(TTY_CONSOLE, "ttybench: %d lines in %d ticks, %d dropped, %d still queued\n",
+		after.rxLines - before.rxLines, RX_TICKS, after.rxDrops - before.rxDrops, after.rxQueued);
+	Exit(0);
+}
+
+
+static void ReaderBench(int n)
+{
+	char buf[TERMINAL_MAX_LINE];
+	TtyStats before, after;
+	int i, status;
+	GetTtyStats(TTY_1, &before);
+	int switches = GetSwitches();
+	for(i = 0; i < n; i++){
+		if(Fork() == 0){
+			for(i = 0; i < READER_LINES; i++)
+				TtyRead(TTY_1, buf, sizeof(buf));
+			Exit(0);
+		}
+	}
+	for(i = 0; i < n; i++)
+		Wait(&status);
+	switches = GetSwitches() - switches;
+	GetTtyStats(TTY_1, &after);
+	int lines = after.rxLines - before.rxLines;
+	if(lines == 0)
+		lines = 1;
+	TtyPrintf(TTY_CONSOLE, "ttybench: %d readers, %d lines, %d switches, %d switches/line\n",
+		n, after.rxLines - before.rxLines, switches, switches / lines);
+	Exit(0);
+}
+
+
+int main(int argc, char *argv[])
+{
+	if(argc > 2 && strcmp(argv[1], "readers") == 0)
+		ReaderBench(atoi(argv[2]));
+	if(argc > 1 && strcmp(argv[1], "rx") == 0)
+		ReceiveBench();
+	char line[WRITE_LEN];
+	TtyStats before, after;
+	int done;
+	memset(line, '.', WRITE_LEN);
+	line[WRITE_LEN - 1] = '\n';
+	GetTtyStats(TTY_1, &before);
+	int start = GetTicks();
+	for(done = 0; done < TOTAL_BYTES; done += WRITE_LEN)
+		TtyWrite(TTY_1, line, WRITE_LEN);
+	int queuedTicks = GetTicks() - start;
+	GetTtyStats(TTY_1, &after);
+	while(after.txQueued > 0){
+		Delay(1);
+		GetTtyStats(TTY_1, &after);
+	}
+	int ticks = GetTicks() - start;
+	if(ticks == 0)
+		ticks = 1;
+	TtyPrintf(TTY_CONSOLE, "ttybench: %d bytes, writes returned after %d ticks, drained after %d ticks\n",
+		TOTAL_BYTES, queuedTicks, ticks);
+	TtyPrintf(TTY_CONSOLE, "ttybench: %d bytes/tick, writer blocked %d ticks\n",
+		(after.txBytes - before.txBytes) / ticks, after.txBlockedTicks - before.txBlockedTicks);
+	Exit(0);
+}
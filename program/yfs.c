@@ -0,0 +1,1012 @@
+#include "../include/custom.h"
+#include "../include/filesystem.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+#include "../include/yfs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INODES_PER_BLOCK	(BLOCKSIZE / INODESIZE)
+#define PTRS_PER_BLOCK		(BLOCKSIZE / sizeof(int))
+#define MAX_FILE_BLOCKS		(NUM_DIRECT + PTRS_PER_BLOCK)
+#define DIRENTS_PER_BLOCK	(BLOCKSIZE / sizeof(struct dir_entry))
+// Inodes of a Disk Formatted by "yfs -f"
+#define FORMAT_INODES		2047
+// Most Inodes That Leave a Data Block besides the Boot Block, Header and Inode Blocks
+#define MAX_INODES		((NUMBLOCKS - 2) * INODES_PER_BLOCK - 1)
+// Initial Buckets of a Directory Index
+#define DIR_HASH_MIN		64
+#define PATH_CACHE_SIZE		64
+// Blocks Reserved after a File Growing at Its End
+#define PREALLOC_BLOCKS		8
+#define MAP_WORDS		((NUMBLOCKS + 31) / 32)
+
+/*
+ * YFS file server.  Serves YfsMsg requests from include/yfs.h for the
+ * FILE_SERVER service.  Disk blocks are cached by the kernel buffer cache;
+ * the server caches INODE_CACHESIZE inodes and reads ahead of sequential
+ * readers.  Each directory looked up gets an in-memory name hash built
+ * from its blocks on first use, and whole paths opened recently are
+ * cached; unlink flushes the path cache.
+ * Blocks are allocated from a bitmap searched a word at a time, starting
+ * at the file's goal block, and a file growing at its end reserves the
+ * next PREALLOC_BLOCKS blocks.  "-n" allocates the first free block
+ * instead, for comparison.  "yfs -f [inodes]" formats the disk first, as does a disk
+ * without a valid header.
+ */
+typedef struct{
+	int inum;		// 0 if Unused
+	int dirty;
+	unsigned int used;	// LRU Stamp
+	int nextPos;		// Where a Sequential Reader Reads Next
+	int raBlock;		// First Block Not yet Read ahead
+	int goal;		// Where the Next Block Is Wanted, 0 if Unknown
+	int preStart;		// Reserved Run of Free Blocks
+	int preCount;
+	int preBlock;		// File Block the Run Continues
+	struct inode inode;
+}CachedInode;
+
+typedef struct DirName{
+	char name[DIRNAMELEN];	// Zero-padded
+	unsigned int hash;
+	int inum;
+	int slot;		// Entry Number in the Directory
+	struct DirName *next;
+}DirName;
+
+typedef struct DirIndex{
+	int dir;
+	int count;
+	int nbuckets;		// Power of Two
+	DirName **buckets;
+	int *freeSlots;		// Cleared Entries to Reuse
+	int nfree;
+	int freeCap;
+	int broken;		// An Insert Ran out of Memory
+	struct DirIndex *next;
+}DirIndex;
+
+typedef struct{
+	int inum;		// 0 if Unused
+	char path[MAXPATHNAMELEN];
+}CachedPath;
+
+static struct fs_header header;
+static int inodeBlocks;			// Blocks Holding the Header and Inodes
+static unsigned int blockMap[MAP_WORDS];	// Bit Set for Used Blocks
+static int allocRotor;				// Goal of Files without Blocks
+static int naiveAlloc;
+static char *inodeUsed;
+static CachedInode inodeCache[INODE_CACHESIZE];
+static unsigned int useClock;
+static int readAhead = YFS_READAHEAD;
+static DirIndex *dirIndexes;
+static CachedPath pathCache[PATH_CACHE_SIZE];
+static int Resolve(char *, int *, char **, int *);
+static int BlockSector(CachedInode *, int, int);
+static void ReleasePrealloc(CachedInode *);
+
+static void ReadInode(int inum, struct inode *inode)
+{
+	char block[BLOCKSIZE];
+	ReadSector(1 + inum / INODES_PER_BLOCK, block);
+	memcpy(inode, block + (inum % INODES_PER_BLOCK) * INODESIZE, sizeof(struct inode));
+}
+
+
+static void WriteInode(int inum, struct inode *inode)
+{
+	char block[BLOCKSIZE];
+	ReadSector(1 + inum / INODES_PER_BLOCK, block);
+	memcpy(block + (inum % INODES_PER_BLOCK) * INODESIZE, inode, sizeof(struct inode));
+	WriteSector(1 + inum / INODES_PER_BLOCK, block);
+}
+
+
+// Return the cached inode, loading it over the least recently used entry
+static CachedInode *GetInode(int inum)
+{
+	int i;
+	CachedInode *victim = &inodeCache[0];
+	if(inum <= 0 || inum > header.num_inodes)
+		return NULL;
+	for(i = 0; i < INODE_CACHESIZE; i++){
+		if(inodeCache[i].inum == inum){
+			inodeCache[i].used = ++useClock;
+			return &inodeCache[i];
+		}
+		if(inodeCache[i].used < victim->used)
+			victim = &inodeCache[i];
+	}
+	ReleasePrealloc(victim);
+	if(victim->inum != 0 && victim->dirty)
+		WriteInode(victim->inum, &victim->inode);
+	victim->inum = inum;
+	victim->dirty = 0;
+	victim->used = ++useClock;
+	victim->nextPos = 0;
+	victim->raBlock = 0;
+	victim->goal = 0;
+	ReadInode(inum, &victim->inode);
+	return victim;
+}
+
+
+static void FlushInodes(void)
+{
+	int i;
+	for(i = 0; i < INODE_CACHESIZE; i++){
+		if(inodeCache[i].inum != 0 && inodeCache[i].dirty){
+			WriteInode(inodeCache[i].inum, &inodeCache[i].inode);
+			inodeCache[i].dirty = 0;
+		}
+	}
+}
+
+
+static void MarkBlock(int b, int used)
+{
+	if(b <= 0 || b >= NUMBLOCKS)
+		return;
+	if(used)
+		blockMap[b / 32] |= 1u << (b % 32);
+	else
+		blockMap[b / 32] &= ~(1u << (b % 32));
+}
+
+
+static int BlockFree(int b)
+{
+	return (blockMap[b / 32] & (1u << (b % 32))) == 0;
+}
+
+
+// First free block at or after goal, wrapping around to the data blocks
+// Full words are skipped 32 blocks at a time, return 0 if the disk is full
+static int FindFreeBlock(int goal)
+{
+	int b, limit;
+	if(goal < inodeBlocks || goal >= header.num_blocks)
+		goal = inodeBlocks;
+	b = goal;
+	limit = header.num_blocks;
+	while(1){
+		while(b < limit){
+			if(b % 32 == 0 && blockMap[b / 32] == 0xFFFFFFFF)
+				b += 32;
+			else if(BlockFree(b))
+				return b;
+			else
+				b++;
+		}
+		if(limit == goal)
+			return 0;
+		b = inodeBlocks;
+		limit = goal;
+	}
+}
+
+
+static void ReleasePrealloc(CachedInode *ci)
+{
+	while(ci->preCount > 0)
+		MarkBlock(ci->preStart + --ci->preCount, 0);
+}
+
+
+// Allocate the block holding file block fileBlock of ci
+static int AllocFileBlock(CachedInode *ci, int fileBlock)
+{
+	int b, n;
+	if(ci->preCount > 0 && fileBlock == ci->preBlock){
+		b = ci->preStart++;
+		ci->preCount--;
+		ci->preBlock++;
+		ci->goal = b + 1;
+		return b;
+	}
+	ReleasePrealloc(ci);
+	if(naiveAlloc){
+		b = FindFreeBlock(inodeBlocks);
+		MarkBlock(b, 1);
+		return b;
+	}
+	if(ci->goal == 0 && fileBlock > 0)
+		ci->goal = BlockSector(ci, fileBlock - 1, 0) + 1;
+	if(ci->goal == 1 || ci->goal == 0)
+		ci->goal = allocRotor;
+	b = FindFreeBlock(ci->goal);
+	if(b == 0)
+		return 0;
+	MarkBlock(b, 1);
+	ci->goal = b + 1;
+	n = 0;
+	if(fileBlock * BLOCKSIZE >= ci->inode.size){
+		while(n < PREALLOC_BLOCKS && b + 1 + n < header.num_blocks && BlockFree(b + 1 + n)){
+			MarkBlock(b + 1 + n, 1);
+			n++;
+		}
+		ci->preStart = b + 1;
+		ci->preCount = n;
+		ci->preBlock = fileBlock + 1;
+	}
+	allocRotor = b + 1 + n;
+	return b;
+}
+
+
+// Allocate a block near the file's goal outside its reserved run
+static int AllocBlock(CachedInode *ci)
+{
+	int b;
+	if(naiveAlloc)
+		b = FindFreeBlock(inodeBlocks);
+	else
+		b = FindFreeBlock(ci->goal);
+	MarkBlock(b, 1);
+	return b;
+}
+
+
+// Blocks of the file that do not follow the previous block on disk
+static int CountExtents(CachedInode *ci)
+{
+	int block, extents = 0, prev = -1;
+	int blocks = (ci->inode.size + BLOCKSIZE - 1) / BLOCKSIZE;
+	for(block = 0; block < blocks; block++){
+		int sector = BlockSector(ci, block, 0);
+		if(sector != 0 && sector != prev + 1)
+			extents++;
+		prev = sector;
+	}
+	return extents;
+}
+
+
+static int AllocInode(void)
+{
+	int inum;
+	for(inum = ROOTINODE + 1; inum <= header.num_inodes; inum++){
+		if(!inodeUsed[inum]){
+			inodeUsed[inum] = 1;
+			return inum;
+		}
+	}
+	return 0;
+}
+
+
+// Sector of the file's block, 0 for a hole unless alloc
+static int BlockSector(CachedInode *ci, int block, int alloc)
+{
+	int ptrs[PTRS_PER_BLOCK];
+	if(block < 0 || block >= MAX_FILE_BLOCKS)
+		return 0;
+	if(block < NUM_DIRECT){
+		if(ci->inode.direct[block] == 0 && alloc){
+			ci->inode.direct[block] = AllocFileBlock(ci, block);
+			ci->dirty = 1;
+		}
+		return ci->inode.direct[block];
+	}
+	if(ci->inode.indirect == 0){
+		if(!alloc)
+			return 0;
+		ci->inode.indirect = AllocBlock(ci);
+		if(ci->inode.indirect == 0)
+			return 0;
+		ci->dirty = 1;
+		memset(ptrs, 0, BLOCKSIZE);
+		WriteSector(ci->inode.indirect, ptrs);
+	}
+	ReadSector(ci->inode.indirect, ptrs);
+	if(ptrs[block - NUM_DIRECT] == 0 && alloc){
+		ptrs[block - NUM_DIRECT] = AllocFileBlock(ci, block);
+		if(ptrs[block - NUM_DIRECT] != 0)
+			WriteSector(ci->inode.indirect, ptrs);
+	}
+	return ptrs[block - NUM_DIRECT];
+}
+
+
+// Queue the next readAhead blocks of a sequential reader
+static void ReadAhead(CachedInode *ci, int pos)
+{
+	int sectors[MAX_FILE_BLOCKS];
+	int n = 0;
+	int block = (pos + BLOCKSIZE - 1) / BLOCKSIZE;
+	int end = block + readAhead;
+	int last = (ci->inode.size + BLOCKSIZE - 1) / BLOCKSIZE;
+	if(end > last)
+		end = last;
+	if(block < ci->raBlock)
+		block = ci->raBlock;
+	for(; block < end; block++){
+		int sector = BlockSector(ci, block, 0);
+		if(sector != 0)
+			sectors[n++] = sector;
+	}
+	if(block > ci->raBlock)
+		ci->raBlock = block;
+	if(n > 0)
+		Prefetch(sectors, n);
+}
+
+
+static int ReadFile(int pid, int inum, int pos, void *buf, int len)
+{
+	char block[BLOCKSIZE];
+	CachedInode *ci = GetInode(inum);
+	if(ci == NULL || ci->inode.type == INODE_FREE || pos < 0 || len < 0)
+		return ERROR;
+	if(pos >= ci->inode.size)
+		return 0;
+	if(len > ci->inode.size - pos)
+		len = ci->inode.size - pos;
+	// A Reader Skipping Around Restarts the Read-ahead Window
+	int sequential = (pos == ci->nextPos);
+	if(!sequential)
+		ci->raBlock = 0;
+	int done = 0;
+	while(done < len){
+		int offset = (pos + done) % BLOCKSIZE;
+		int count = BLOCKSIZE - offset;
+		if(count > len - done)
+			count = len - done;
+		int sector = BlockSector(ci, (pos + done) / BLOCKSIZE, 0);
+		if(sector == 0)
+			memset(block, 0, BLOCKSIZE);
+		else
+			ReadSector(sector, block);
+		if(CopyTo(pid, buf + done, block + offset, count) == ERROR)
+			return ERROR;
+		done += count;
+	}
+	ci->nextPos = pos + len;
+	if(sequential && readAhead > 0)
+		ReadAhead(ci, ci->nextPos);
+	return len;
+}
+
+
+static int WriteFile(int pid, int inum, int pos, void *buf, int len)
+{
+	char block[BLOCKSIZE];
+	CachedInode *ci = GetInode(inum);
+	if(ci == NULL || ci->inode.type != INODE_REGULAR || pos < 0 || len < 0)
+		return ERROR;
+	if(pos + len > MAX_FILE_BLOCKS * BLOCKSIZE)
+		len = MAX_FILE_BLOCKS * BLOCKSIZE - pos;
+	int done = 0;
+	while(done < len){
+		int offset = (pos + done) % BLOCKSIZE;
+		int count = BLOCKSIZE - offset;
+		if(count > len - done)
+			count = len - done;
+		int sector = BlockSector(ci, (pos + done) / BLOCKSIZE, 0);
+		if(sector == 0){
+			sector = BlockSector(ci, (pos + done) / BLOCKSIZE, 1);
+			if(sector == 0)
+				break;
+			memset(block, 0, BLOCKSIZE);
+		}else if(count < BLOCKSIZE)
+			ReadSector(sector, block);
+		if(CopyFrom(pid, block + offset, buf + done, count) == ERROR)
+			return ERROR;
+		WriteSector(sector, block);
+		done += count;
+	}
+	if(pos + done > ci->inode.size){
+		ci->inode.size = pos + done;
+		ci->dirty = 1;
+	}
+	if(done == 0 && len > 0)
+		return ERROR;
+	return done;
+}
+
+
+// Zero-padded Name as Stored in a dir_entry
+static void MakeKey(char *key, char *name, int len)
+{
+	memset(key, 0, DIRNAMELEN);
+	memcpy(key, name, len);
+}
+
+
+static unsigned int NameHash(char *key)
+{
+	unsigned int hash = 2166136261u;
+	int i;
+	for(i = 0; i < DIRNAMELEN && key[i] != '\0'; i++)
+		hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+	return hash;
+}
+
+
+static void IndexInsert(DirIndex *index, char *key, int inum, int slot)
+{
+	int i;
+	if(index->count >= 2 * index->nbuckets){
+		// Double the Buckets to Keep Chains Short
+		DirName **buckets = calloc(2 * index->nbuckets, sizeof(DirName *));
+		if(buckets != NULL){
+			for(i = 0; i < index->nbuckets; i++){
+				DirName *e = index->buckets[i];
+				while(e != NULL){
+					DirName *next = e->next;
+					e->next = buckets[e->hash & (2 * index->nbuckets - 1)];
+					buckets[e->hash & (2 * index->nbuckets - 1)] = e;
+					e = next;
+				}
+			}
+			free(index->buckets);
+			index->buckets = buckets;
+			index->nbuckets *= 2;
+		}
+	}
+	DirName *e = malloc(sizeof(DirName));
+	if(e == NULL){
+		index->broken = 1;
+		return;
+	}
+	memcpy(e->name, key, DIRNAMELEN);
+	e->hash = NameHash(key);
+	e->inum = inum;
+	e->slot = slot;
+	e->next = index->buckets[e->hash & (index->nbuckets - 1)];
+	index->buckets[e->hash & (index->nbuckets - 1)] = e;
+	index->count++;
+}
+
+
+static DirName *IndexFind(DirIndex *index, char *key)
+{
+	DirName *e = index->buckets[NameHash(key) & (index->nbuckets - 1)];
+	while(e != NULL && memcmp(e->name, key, DIRNAMELEN) != 0)
+		e = e->next;
+	return e;
+}
+
+
+static void PushFreeSlot(DirIndex *index, int slot)
+{
+	if(index->nfree == index->freeCap){
+		int *slots = realloc(index->freeSlots, 2 * index->freeCap * sizeof(int));
+		if(slots == NULL)
+			return;
+		index->freeSlots = slots;
+		index->freeCap *= 2;
+	}
+	index->freeSlots[index->nfree++] = slot;
+}
+
+
+static void DropIndex(DirIndex *index)
+{
+	DirIndex **link = &dirIndexes;
+	int i;
+	while(*link != index)
+		link = &(*link)->next;
+	*link = index->next;
+	for(i = 0; i < index->nbuckets; i++){
+		DirName *e = index->buckets[i];
+		while(e != NULL){
+			DirName *next = e->next;
+			free(e);
+			e = next;
+		}
+	}
+	free(index->buckets);
+	free(index->freeSlots);
+	free(index);
+}
+
+
+// Index of directory dir, read from its blocks on first use
+// NULL if memory runs out, callers then scan the blocks
+static DirIndex *GetDirIndex(CachedInode *ci)
+{
+	struct dir_entry entries[DIRENTS_PER_BLOCK];
+	char key[DIRNAMELEN];
+	DirIndex *index;
+	int slot, n, len;
+	for(index = dirIndexes; index != NULL; index = index->next)
+		if(index->dir == ci->inum)
+			return index;
+	index = calloc(1, sizeof(DirIndex));
+	if(index == NULL)
+		return NULL;
+	n = ci->inode.size / sizeof(struct dir_entry);
+	index->dir = ci->inum;
+	index->nbuckets = DIR_HASH_MIN;
+	while(index->nbuckets < n)
+		index->nbuckets *= 2;
+	index->buckets = calloc(index->nbuckets, sizeof(DirName *));
+	index->freeCap = DIR_HASH_MIN;
+	index->freeSlots = malloc(index->freeCap * sizeof(int));
+	index->next = dirIndexes;
+	dirIndexes = index;
+	if(index->buckets == NULL || index->freeSlots == NULL){
+		DropIndex(index);
+		return NULL;
+	}
+	for(slot = 0; slot < n; slot++){
+		if(slot % DIRENTS_PER_BLOCK == 0){
+			int sector = BlockSector(ci, slot / DIRENTS_PER_BLOCK, 0);
+			if(sector == 0)
+				memset(entries, 0, BLOCKSIZE);
+			else
+				ReadSector(sector, entries);
+		}
+		struct dir_entry *entry = &entries[slot % DIRENTS_PER_BLOCK];
+		if(entry->inum == 0){
+			PushFreeSlot(index, slot);
+			continue;
+		}
+		for(len = 0; len < DIRNAMELEN && entry->name[len] != '\0'; len++);
+		MakeKey(key, entry->name, len);
+		IndexInsert(index, key, entry->inum, slot);
+	}
+	if(index->broken){
+		DropIndex(index);
+		return NULL;
+	}
+	return index;
+}
+
+
+// Slot of key in the directory by scanning its blocks, or of a free entry if key is NULL
+// Return -1 if not found
+static int DirScan(CachedInode *ci, char *key)
+{
+	struct dir_entry entries[DIRENTS_PER_BLOCK];
+	int slot, n = ci->inode.size / sizeof(struct dir_entry);
+	for(slot = 0; slot < n; slot++){
+		if(slot % DIRENTS_PER_BLOCK == 0){
+			int sector = BlockSector(ci, slot / DIRENTS_PER_BLOCK, 0);
+			if(sector == 0)
+				memset(entries, 0, BLOCKSIZE);
+			else
+				ReadSector(sector, entries);
+		}
+		struct dir_entry *entry = &entries[slot % DIRENTS_PER_BLOCK];
+		if(key == NULL && entry->inum == 0)
+			return slot;
+		if(key != NULL && entry->inum != 0 && strncmp(entry->name, key, DIRNAMELEN) == 0)
+			return slot;
+	}
+	return -1;
+}
+
+
+// Write entry slot of the directory, growing it when slot is past the end
+static int WriteDirEntry(CachedInode *ci, int slot, char *key, int inum)
+{
+	struct dir_entry entries[DIRENTS_PER_BLOCK];
+	int block = slot / DIRENTS_PER_BLOCK;
+	int sector = BlockSector(ci, block, 0);
+	if(sector == 0){
+		sector = BlockSector(ci, block, 1);
+		if(sector == 0)
+			return ERROR;
+		memset(entries, 0, BLOCKSIZE);
+	}else
+		ReadSector(sector, entries);
+	memcpy(entries[slot % DIRENTS_PER_BLOCK].name, key, DIRNAMELEN);
+	entries[slot % DIRENTS_PER_BLOCK].inum = inum;
+	WriteSector(sector, entries);
+	if((slot + 1) * sizeof(struct dir_entry) > ci->inode.size){
+		ci->inode.size = (slot + 1) * sizeof(struct dir_entry);
+		ci->dirty = 1;
+	}
+	return 0;
+}
+
+
+// Send the sectors of n blocks from pos to the client, 0 for holes and past the end
+static int MapFile(int pid, int inum, int pos, int n, void *buf)
+{
+	int sectors[MAX_FILE_BLOCKS];
+	int i;
+	CachedInode *ci = GetInode(inum);
+	if(ci == NULL || ci->inode.type != INODE_REGULAR || pos < 0 || pos % BLOCKSIZE != 0 || n <= 0 || n > MAX_FILE_BLOCKS)
+		return ERROR;
+	for(i = 0; i < n; i++){
+		int block = pos / BLOCKSIZE + i;
+		if(block * BLOCKSIZE < ci->inode.size)
+			sectors[i] = BlockSector(ci, block, 0);
+		else
+			sectors[i] = 0;
+	}
+	if(CopyTo(pid, buf, sectors, n * sizeof(int)) == ERROR)
+		return ERROR;
+	return n;
+}
+
+
+// Inode of the entry name[0..len) in directory dir, 0 if none
+static int DirLookup(int dir, char *name, int len)
+{
+	char key[DIRNAMELEN];
+	CachedInode *ci = GetInode(dir);
+	if(ci == NULL || ci->inode.type != INODE_DIRECTORY || len > DIRNAMELEN)
+		return 0;
+	MakeKey(key, name, len);
+	DirIndex *index = GetDirIndex(ci);
+	if(index != NULL){
+		DirName *e = IndexFind(index, key);
+		if(e == NULL)
+			return 0;
+		return e->inum;
+	}
+	int slot = DirScan(ci, key);
+	if(slot == -1)
+		return 0;
+	struct dir_entry entries[DIRENTS_PER_BLOCK];
+	ReadSector(BlockSector(ci, slot / DIRENTS_PER_BLOCK, 0), entries);
+	return entries[slot % DIRENTS_PER_BLOCK].inum;
+}
+
+
+// Add name[0..len) -> inum to directory dir, reusing a free entry
+static int DirAdd(int dir, char *name, int len, int inum)
+{
+	char key[DIRNAMELEN];
+	CachedInode *ci = GetInode(dir);
+	DirIndex *index = GetDirIndex(ci);
+	int slot;
+	MakeKey(key, name, len);
+	if(index != NULL && index->nfree > 0)
+		slot = index->freeSlots[--index->nfree];
+	else if(index != NULL)
+		slot = ci->inode.size / sizeof(struct dir_entry);
+	else{
+		slot = DirScan(ci, NULL);
+		if(slot == -1)
+			slot = ci->inode.size / sizeof(struct dir_entry);
+	}
+	if(WriteDirEntry(ci, slot, key, inum) == ERROR){
+		if(index != NULL && slot < ci->inode.size / sizeof(struct dir_entry))
+			PushFreeSlot(index, slot);
+		return ERROR;
+	}
+	if(index != NULL){
+		IndexInsert(index, key, inum, slot);
+		if(index->broken)
+			DropIndex(index);
+	}
+	return 0;
+}
+
+
+// Clear the entry name[0..len) of directory dir, return its inode or 0
+static int DirRemove(int dir, char *name, int len)
+{
+	char key[DIRNAMELEN];
+	CachedInode *ci = GetInode(dir);
+	DirIndex *index = GetDirIndex(ci);
+	int slot, inum;
+	MakeKey(key, name, len);
+	if(index != NULL){
+		DirName *e = IndexFind(index, key);
+		if(e == NULL)
+			return 0;
+		DirName **link = &index->buckets[e->hash & (index->nbuckets - 1)];
+		while(*link != e)
+			link = &(*link)->next;
+		*link = e->next;
+		index->count--;
+		slot = e->slot;
+		inum = e->inum;
+		free(e);
+		PushFreeSlot(index, slot);
+	}else{
+		slot = DirScan(ci, key);
+		if(slot == -1)
+			return 0;
+		inum = DirLookup(dir, name, len);
+	}
+	memset(key, 0, DIRNAMELEN);
+	WriteDirEntry(ci, slot, key, 0);
+	return inum;
+}
+
+
+// Inode of an absolute path through the path cache
+static int LookupPath(char *path)
+{
+	unsigned int hash = 2166136261u;
+	char *p;
+	for(p = path; *p != '\0'; p++)
+		hash = (hash ^ (unsigned char)*p) * 16777619u;
+	CachedPath *cp = &pathCache[hash % PATH_CACHE_SIZE];
+	if(cp->inum != 0 && strcmp(cp->path, path) == 0)
+		return cp->inum;
+	int inum = Resolve(path, NULL, NULL, NULL);
+	if(inum != 0){
+		cp->inum = inum;
+		strcpy(cp->path, path);
+	}
+	return inum;
+}
+
+
+// Walk path from the root, return the inode of its last component
+// With parent, return the directory holding it and leave the component in name
+static int Resolve(char *path, int *parent, char **name, int *len)
+{
+	int dir = ROOTINODE, inum = ROOTINODE;
+	char *p = path;
+	while(*p == '/')
+		p++;
+	if(parent != NULL)
+		*parent = 0;
+	while(*p != '\0'){
+		char *end = p;
+		while(*end != '/' && *end != '\0')
+			end++;
+		dir = inum;
+		if(dir == 0){
+			if(parent != NULL)
+				*parent = 0;
+			return 0;
+		}
+		inum = DirLookup(dir, p, end - p);
+		if(parent != NULL){
+			*parent = dir;
+			*name = p;
+			*len = end - p;
+		}
+		p = end;
+		while(*p == '/')
+			p++;
+	}
+	return inum;
+}
+
+
+static void InitInode(CachedInode *ci, int type)
+{
+	memset(&ci->inode, 0, sizeof(struct inode));
+	ci->inode.type = type;
+	ci->inode.nlink = 1;
+	ci->dirty = 1;
+	ci->nextPos = 0;
+	ci->raBlock = 0;
+	ci->goal = 0;
+}
+
+
+static void FreeBlocks(CachedInode *ci)
+{
+	int ptrs[PTRS_PER_BLOCK];
+	int i;
+	ReleasePrealloc(ci);
+	for(i = 0; i < NUM_DIRECT; i++){
+		MarkBlock(ci->inode.direct[i], 0);
+		ci->inode.direct[i] = 0;
+	}
+	if(ci->inode.indirect != 0){
+		ReadSector(ci->inode.indirect, ptrs);
+		for(i = 0; i < PTRS_PER_BLOCK; i++)
+			MarkBlock(ptrs[i], 0);
+		MarkBlock(ci->inode.indirect, 0);
+		ci->inode.indirect = 0;
+	}
+	ci->goal = 0;
+	ci->inode.size = 0;
+	ci->dirty = 1;
+}
+
+
+static int CreateFile(char *path, int type)
+{
+	int parent, len;
+	char *name;
+	int inum = Resolve(path, &parent, &name, &len);
+	if(parent == 0 || len == 0 || len > DIRNAMELEN)
+		return ERROR;
+	if(inum != 0){
+		CachedInode *ci = GetInode(inum);
+		if(type == INODE_DIRECTORY || ci->inode.type != INODE_REGULAR)
+			return ERROR;
+		FreeBlocks(ci);
+		return inum;
+	}
+	inum = AllocInode();
+	if(inum == 0)
+		return ERROR;
+	CachedInode *ci = GetInode(inum);
+	InitInode(ci, type);
+	if(type == INODE_DIRECTORY){
+		DirAdd(inum, ".", 1, inum);
+		DirAdd(inum, "..", 2, parent);
+	}
+	if(DirAdd(parent, name, len, inum) == ERROR){
+		ci->inode.type = INODE_FREE;
+		inodeUsed[inum] = 0;
+		return ERROR;
+	}
+	return inum;
+}
+
+
+static int UnlinkFile(char *path)
+{
+	int parent, len;
+	char *name;
+	int inum = Resolve(path, &parent, &name, &len);
+	if(inum == 0 || parent == 0)
+		return ERROR;
+	CachedInode *ci = GetInode(inum);
+	if(ci->inode.type != INODE_REGULAR)
+		return ERROR;
+	DirRemove(parent, name, len);
+	memset(pathCache, 0, sizeof(pathCache));
+	ci = GetInode(inum);
+	if(--ci->inode.nlink <= 0){
+		FreeBlocks(ci);
+		ci->inode.type = INODE_FREE;
+		inodeUsed[inum] = 0;
+	}
+	ci->dirty = 1;
+	return 0;
+}
+
+
+// Mark the boot, header and inode blocks and the bits past the disk used
+static void InitBlockMap(void)
+{
+	int b;
+	memset(blockMap, 0, sizeof(blockMap));
+	blockMap[0] = 1;
+	for(b = 0; b < inodeBlocks; b++)
+		MarkBlock(b, 1);
+	for(b = header.num_blocks; b < MAP_WORDS * 32; b++)
+		blockMap[b / 32] |= 1u << (b % 32);
+	allocRotor = inodeBlocks;
+}
+
+
+static void Format(int inodes)
+{
+	char block[BLOCKSIZE];
+	int b;
+	memset(&header, 0, sizeof(header));
+	header.num_blocks = NUMBLOCKS;
+	header.num_inodes = inodes;
+	inodeBlocks = 1 + (inodes + 1 + INODES_PER_BLOCK - 1) / INODES_PER_BLOCK;
+	memset(block, 0, BLOCKSIZE);
+	for(b = 2; b < inodeBlocks; b++)
+		WriteSector(b, block);
+	memcpy(block, &header, sizeof(header));
+	WriteSector(1, block);
+	InitBlockMap();
+	inodeUsed = calloc(inodes + 1, 1);
+	inodeUsed[0] = inodeUsed[ROOTINODE] = 1;
+	CachedInode *ci = GetInode(ROOTINODE);
+	InitInode(ci, INODE_DIRECTORY);
+	DirAdd(ROOTINODE, ".", 1, ROOTINODE);
+	DirAdd(ROOTINODE, "..", 2, ROOTINODE);
+	FlushInodes();
+}
+
+
+// Rebuild the free block and inode maps from the inodes on disk
+static void Mount(void)
+{
+	int ptrs[PTRS_PER_BLOCK];
+	struct inode inode;
+	int inum, i;
+	inodeBlocks = 1 + (header.num_inodes + 1 + INODES_PER_BLOCK - 1) / INODES_PER_BLOCK;
+	InitBlockMap();
+	inodeUsed = calloc(header.num_inodes + 1, 1);
+	inodeUsed[0] = 1;
+	for(inum = ROOTINODE; inum <= header.num_inodes; inum++){
+		ReadInode(inum, &inode);
+		if(inode.type == INODE_FREE)
+			continue;
+		inodeUsed[inum] = 1;
+		for(i = 0; i < NUM_DIRECT; i++)
+			MarkBlock(inode.direct[i], 1);
+		if(inode.indirect != 0){
+			MarkBlock(inode.indirect, 1);
+			ReadSector(inode.indirect, ptrs);
+			for(i = 0; i < PTRS_PER_BLOCK; i++)
+				MarkBlock(ptrs[i], 1);
+		}
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	char block[BLOCKSIZE];
+	char path[MAXPATHNAMELEN];
+	YfsMsg msg;
+	int pid, result, i;
+	int format = 0, inodes = FORMAT_INODES;
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-f") == 0)
+			format = 1;
+		else if(strcmp(argv[i], "-n") == 0)
+			naiveAlloc = 1;
+		else if(argv[i][0] == '-'){
+			TtyPrintf(TTY_CONSOLE, "yfs: Unknown Option %s\n", argv[i]);
+			Exit(1);
+		}else
+			inodes = atoi(argv[i]);
+	}
+	if(inodes < 1 || inodes > MAX_INODES){
+		TtyPrintf(TTY_CONSOLE, "yfs: Inode Count Must Be 1 to %d\n", MAX_INODES);
+		Exit(1);
+	}
+	ReadSector(1, block);
+	memcpy(&header, block, sizeof(header));
+	if(format || header.num_blocks != NUMBLOCKS || header.num_inodes <= 0 || header.num_inodes > MAX_INODES)
+		Format(inodes);
+	else
+		Mount();
+	if(Register(FILE_SERVER) == ERROR){
+		TtyPrintf(TTY_CONSOLE, "yfs: Cannot Register Service %d\n", FILE_SERVER);
+		Exit(1);
+	}
+	TtyPrintf(TTY_CONSOLE, "yfs: %d blocks, %d inodes\n", header.num_blocks, header.num_inodes);
+	while(1){
+		pid = Receive(&msg);
+		if(pid == ERROR)
+			continue;
+		result = ERROR;
+		switch(msg.op){
+			case YFS_OPEN:
+			case YFS_CREATE:
+			case YFS_MKDIR:
+			case YFS_UNLINK:
+				if(msg.len <= 0 || msg.len > MAXPATHNAMELEN || CopyFrom(pid, path, msg.buf, msg.len) == ERROR)
+					break;
+				path[msg.len - 1] = '\0';
+				if(msg.op == YFS_OPEN){
+					result = LookupPath(path);
+					if(result == 0)
+						result = ERROR;
+					else
+						msg.len = GetInode(result)->inode.size;
+				}else if(msg.op == YFS_CREATE)
+					result = CreateFile(path, INODE_REGULAR);
+				else if(msg.op == YFS_UNLINK)
+					result = UnlinkFile(path);
+				else if(CreateFile(path, INODE_DIRECTORY) != ERROR)
+					result = 0;
+				break;
+			case YFS_READ:
+				result = ReadFile(pid, msg.inum, msg.pos, msg.buf, msg.len);
+				break;
+			case YFS_WRITE:
+				result = WriteFile(pid, msg.inum, msg.pos, msg.buf, msg.len);
+				break;
+			case YFS_BMAP:
+				result = MapFile(pid, msg.inum, msg.pos, msg.len, msg.buf);
+				break;
+			case YFS_EXTENTS:
+				if(GetInode(msg.inum) != NULL)
+					result = CountExtents(GetInode(msg.inum));
+				break;
+			case YFS_CONFIG:
+				result = readAhead;
+				if(msg.arg >= 0)
+					readAhead = msg.arg;
+				break;
+			case YFS_SHUTDOWN:
+				FlushInodes();
+				SyncSectors();
+				msg.op = 0;
+				Reply(&msg, pid);
+				Exit(0);
+		}
+		msg.op = result;
+		Reply(&msg, pid);
+	}
+}
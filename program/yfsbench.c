@@ -0,0 +1,80 @@
+#include "../include/custom.h"
+#include "../include/hardware.h"
+#include "../include/yalnix.h"
+#include "../include/yfs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FILE_BLOCKS	128
+#define CHUNK		BLOCKSIZE
+
+static char *serverArgs[] = {"program/yfs", "-f", NULL};
+
+/*
+ * Start a freshly formatted YFS server, write a FILE_BLOCKS block file
+ * and read it back sequentially and at random block offsets, with and
+ * without read-ahead.  Report bytes per 100 ticks and the kernel buffer
+ * cache hits and prefetches of each pass.
+ */
+static void ReadPass(int fd, int random, int readahead)
+{
+	char buf[CHUNK];
+	BcacheStats before, after;
+	unsigned int seed = 4321;
+	int i, total = 0;
+	SetReadAhead(readahead);
+	GetBcacheStats(&before);
+	int start = GetTicks();
+	Seek(fd, 0, SEEK_SET);
+	for(i = 0; i < FILE_BLOCKS; i++){
+		if(random){
+			seed = seed * 1103515245 + 12345;
+			Seek(fd, ((seed >> 8) % FILE_BLOCKS) * CHUNK, SEEK_SET);
+		}
+		total += Read(fd, buf, CHUNK);
+	}
+	int ticks = GetTicks() - start;
+	if(ticks == 0)
+		ticks = 1;
+	GetBcacheStats(&after);
+	char *order = "sequential";
+	if(random)
+		order = "random";
+	TtyPrintf(TTY_CONSOLE, "yfsbench: %s read-ahead %d, %d bytes in %d ticks, %d bytes/100 ticks, %d hits, %d prefetched\n",
+		order, readahead, total, ticks, total * 100 / ticks,
+		after.hits - before.hits, after.prefetches - before.prefetches);
+}
+
+
+int main(int argc, char *argv[])
+{
+	char buf[CHUNK];
+	int i, status;
+	int server = Fork();
+	if(server == 0){
+		Exec(serverArgs[0], serverArgs);
+		Exit(1);
+	}
+	// Wait for the Server to Register
+	while(SetReadAhead(-1) == ERROR)
+		Delay(1);
+	int fd = Create("/bench");
+	if(fd == ERROR){
+		TtyPrintf(TTY_CONSOLE, "yfsbench: Create Failed\n");
+		Exit(1);
+	}
+	memset(buf, 'y', CHUNK);
+	int start = GetTicks();
+	for(i = 0; i < FILE_BLOCKS; i++)
+		Write(fd, buf, CHUNK);
+	TtyPrintf(TTY_CONSOLE, "yfsbench: wrote %d bytes in %d ticks\n", FILE_BLOCKS * CHUNK, GetTicks() - start);
+	ReadPass(fd, 0, 0);
+	ReadPass(fd, 0, YFS_READAHEAD);
+	ReadPass(fd, 1, 0);
+	ReadPass(fd, 1, YFS_READAHEAD);
+	Close(fd);
+	Shutdown();
+	Wait(&status);
+	Exit(0);
+}
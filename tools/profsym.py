@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Symbolize a profiler dump (prof dump FILE, written to dump-FILE) into a flat profile or folded stacks.
+
+Kernel pcs, below the region 1 base, are looked up in the yalnix binary,
+user pcs in the program each profile was taken of.  The flat profile
+lists samples per function, --folded prints one "program;caller;...;function
+count" line per stack for flamegraph.pl or speedscope.  Page mode buckets
+are reported by page as "function+page".
+
+usage: profsym.py [--kernel yalnix] [--root DIR] [--folded] DUMP
+"""
+
+import argparse
+import bisect
+import struct
+import subprocess
+import sys
+from collections import Counter
+
+PROF_MAGIC = 0x46525059
+PROF_VERSION = 1
+PROF_PAGE, PROF_PC = 1, 2
+PROF_DEPTH = 4
+PROF_BUCKETS = 128
+PCB_NAME_LEN = 32
+VMEM_1_BASE = 0x100000
+
+HEADER = struct.Struct('<IIIII')
+PROFILE = struct.Struct('<i%dsIII' % PCB_NAME_LEN)
+BUCKET = struct.Struct('<%dII' % PROF_DEPTH)
+
+
+def read_dump(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, version, mode, count, lost = HEADER.unpack_from(data, 0)
+    if magic != PROF_MAGIC or version != PROF_VERSION:
+        sys.exit('%s: not a version %d profile dump' % (path, PROF_VERSION))
+    profiles = []
+    off = HEADER.size
+    for _ in range(count):
+        pid, name, samples, plost, used = PROFILE.unpack_from(data, off)
+        off += PROFILE.size
+        buckets = []
+        for _ in range(PROF_BUCKETS):
+            fields = BUCKET.unpack_from(data, off)
+            off += BUCKET.size
+            if fields[-1]:
+                buckets.append((fields[:PROF_DEPTH], fields[-1]))
+        profiles.append((pid, name.split(b'\0')[0].decode(), samples, plost, buckets))
+    return mode, lost, profiles
+
+
+class Symbols:
+    """Function symbols of one binary, from nm."""
+
+    def __init__(self, path):
+        self.addrs, self.names = [], []
+        try:
+            out = subprocess.run(['nm', '-n', '--defined-only', path],
+                                 capture_output=True, text=True, check=True).stdout
+        except (OSError, subprocess.CalledProcessError):
+            sys.stderr.write('profsym: no symbols for %s\n' % path)
+            return
+        for line in out.splitlines():
+            fields = line.split()
+            if len(fields) == 3 and fields[1] in 'TtWw':
+                self.addrs.append(int(fields[0], 16))
+                self.names.append(fields[2])
+
+    def lookup(self, pc):
+        i = bisect.bisect_right(self.addrs, pc) - 1
+        if i < 0:
+            return '0x%x' % pc
+        return self.names[i]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--kernel', default='yalnix')
+    parser.add_argument('--root', default='.', help='directory programs were run from')
+    parser.add_argument('--folded', action='store_true')
+    parser.add_argument('dump')
+    args = parser.parse_args()
+
+    mode, lost, profiles = read_dump(args.dump)
+    binaries = {}
+
+    def symbols(path):
+        if path not in binaries:
+            binaries[path] = Symbols(path)
+        return binaries[path]
+
+    def name(program, pc):
+        if pc < VMEM_1_BASE:
+            sym = symbols(args.kernel).lookup(pc)
+        else:
+            sym = symbols(args.root + '/' + program).lookup(pc)
+        if mode == PROF_PAGE:
+            return '%s+page 0x%x' % (sym, pc)
+        return sym
+
+    flat = Counter()
+    folded = Counter()
+    total = 0
+    for pid, program, samples, plost, buckets in profiles:
+        total += samples
+        if plost:
+            sys.stderr.write('profsym: pid %d %s lost %d samples\n' % (pid, program, plost))
+        for pcs, count in buckets:
+            frames = [name(program, pc) for pc in pcs if pc]
+            flat[(program, frames[0])] += count
+            folded[';'.join([program] + frames[::-1])] += count
+    if lost:
+        sys.stderr.write('profsym: %d samples found no free profile\n' % lost)
+
+    if args.folded:
+        for stack, count in sorted(folded.items()):
+            print('%s %d' % (stack, count))
+        return
+    print('%8s %6s  %-20s %s' % ('samples', '%', 'program', 'function'))
+    for (program, func), count in flat.most_common():
+        print('%8d %6.2f  %-20s %s' % (count, 100.0 * count / max(total, 1), program, func))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Convert a kernel trace dump (trace dump FILE, written to dump-FILE) to Chrome trace JSON.
+
+The output loads in chrome://tracing and ui.perfetto.dev: one track per
+pid with "running" slices from context switches and a slice per system
+call, other events shown as instants.  Timestamps are microseconds of
+the form tick * 1000 + the event's order within the tick.
+
+usage: trace2chrome.py DUMP [OUT.json]
+"""
+
+import json
+import struct
+import sys
+
+TRACE_MAGIC = 0x43525459
+TRACE_VERSION = 1
+HEADER = struct.Struct('<IIII')
+EVENT = struct.Struct('<IIHHii')
+
+SWITCH, SYSCALL, SYSRET, WAKEUP, ALLOC, FREE, TRAP, TTY_RX, TTY_TX = range(1, 10)
+
+SYSCALLS = {
+    0x01: 'Fork', 0x02: 'Exec', 0x03: 'Exit', 0x04: 'Wait', 0x05: 'GetPid',
+    0x06: 'Brk', 0x07: 'Delay', 0x21: 'TtyRead', 0x22: 'TtyWrite',
+    0x31: 'Register', 0x32: 'Send', 0x33: 'Receive', 0x35: 'Reply',
+    0x37: 'CopyFrom', 0x38: 'CopyTo', 0x41: 'ReadSector', 0x42: 'WriteSector',
+    0x48: 'PipeInit', 0x49: 'PipeRead', 0x4A: 'PipeWrite',
+    0x63: 'LockInit', 0x64: 'Acquire', 0x65: 'Release', 0x66: 'CvarInit',
+    0x67: 'CvarSignal', 0x68: 'CvarBroadcast', 0x69: 'CvarWait',
+    0x6A: 'Reclaim', 0x70: 'Custom0', 0x71: 'Custom1', 0x72: 'Custom2',
+}
+
+TRAPS = {0: 'kernel', 1: 'clock', 2: 'illegal', 3: 'memory', 4: 'math',
+         5: 'tty receive', 6: 'tty transmit', 7: 'disk'}
+
+INSTANTS = {WAKEUP: 'wakeup', ALLOC: 'alloc', FREE: 'free', TRAP: 'trap',
+            TTY_RX: 'tty rx', TTY_TX: 'tty tx'}
+
+
+def read_dump(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, version, count, dropped = HEADER.unpack_from(data, 0)
+    if magic != TRACE_MAGIC or version != TRACE_VERSION:
+        sys.exit('%s: not a version %d trace dump' % (path, TRACE_VERSION))
+    events = [EVENT.unpack_from(data, HEADER.size + i * EVENT.size)
+              for i in range(count)]
+    return events, dropped
+
+
+def convert(events):
+    out = []
+    running = {}    # pid -> start of its running slice
+    calls = {}      # pid -> (code, start) of its open system call
+    first = {}      # tick -> seq of its first event
+    end = 0
+    for tick, seq, etype, pid, arg0, arg1 in events:
+        ts = tick * 1000 + seq - first.setdefault(tick, seq)
+        end = max(end, ts)
+        if etype == SWITCH:
+            if arg0 in running:
+                start = running.pop(arg0)
+                out.append({'name': 'running', 'ph': 'X', 'pid': arg0, 'tid': arg0,
+                            'ts': start, 'dur': ts - start})
+            running[arg1] = ts
+        elif etype == SYSCALL:
+            calls[pid] = (arg0, ts)
+        elif etype == SYSRET:
+            # Fork returns in a child that never made the call
+            if pid in calls and calls[pid][0] == arg0:
+                start = calls.pop(pid)[1]
+                out.append({'name': SYSCALLS.get(arg0, 'syscall 0x%x' % arg0),
+                            'cat': 'syscall', 'ph': 'X', 'pid': pid, 'tid': pid,
+                            'ts': start, 'dur': ts - start, 'args': {'ret': arg1}})
+        else:
+            name = INSTANTS.get(etype, 'event %d' % etype)
+            if etype == TRAP:
+                name = 'trap ' + TRAPS.get(arg0, str(arg0))
+            out.append({'name': name, 'ph': 'i', 's': 't', 'pid': pid, 'tid': pid,
+                        'ts': ts, 'args': {'arg0': arg0, 'arg1': arg1}})
+    # Close What Was Still Open at the Dump
+    for pid, start in running.items():
+        out.append({'name': 'running', 'ph': 'X', 'pid': pid, 'tid': pid,
+                    'ts': start, 'dur': end - start})
+    for pid, (code, start) in calls.items():
+        out.append({'name': SYSCALLS.get(code, 'syscall 0x%x' % code),
+                    'cat': 'syscall', 'ph': 'X', 'pid': pid, 'tid': pid,
+                    'ts': start, 'dur': end - start})
+    for pid in sorted(set(e['pid'] for e in out)):
+        out.append({'name': 'process_name', 'ph': 'M', 'pid': pid,
+                    'args': {'name': 'idle' if pid == 0 else 'pid %d' % pid}})
+    return out
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__.strip().splitlines()[-1])
+    events, dropped = read_dump(sys.argv[1])
+    trace = {'traceEvents': convert(events),
+             'otherData': {'events': len(events), 'dropped': dropped}}
+    if len(sys.argv) > 2:
+        with open(sys.argv[2], 'w') as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()